@@ -0,0 +1,223 @@
+/*******************************************************************************
+ * IonScript                                                                   *
+ * (c) 2010-2011 Canio Massimo Tristano <massimo.tristano@gmail.com>           *
+ *                                                                             *
+ * This software is provided 'as-is', without any express or implied           *
+ * warranty. In no event will the authors be held liable for any damages       *
+ * arising from the use of this software.                                      *
+ *                                                                             *
+ * Permission is granted to anyone to use this software for any purpose,       *
+ * including commercial applications, and to alter it and redistribute it      *
+ * freely, subject to the following restrictions:                              *
+ *                                                                             *
+ * 1. The origin of this software must not be misrepresented; you must not     *
+ * claim that you wrote the original software. If you use this software        *
+ * in a product, an acknowledgment in the product documentation would be       *
+ * appreciated but is not required.                                            *
+ *                                                                             *
+ * 2. Altered source versions must be plainly marked as such, and must not be  *
+ * misrepresented as being the original software.                              *
+ *                                                                             *
+ * 3. This notice may not be removed or altered from any source                *
+ * distribution.                                                               *
+ ******************************************************************************/
+
+#include "Allocator.h"
+
+#include <new>
+#include <cstring>
+#include <mutex>
+
+using namespace std;
+using namespace ionscript;
+
+const size_t PoolAllocator::kGranularity;
+const size_t PoolAllocator::kMaxPooledSize;
+const size_t PoolAllocator::kChunkSize;
+const size_t ArenaAllocator::kChunkSize;
+
+namespace {
+
+   thread_local Allocator* tpCurrent = 0;
+
+   /** Room before every block for the allocator that must free it. Cells need no more than pointer alignment. */
+   const size_t kPrefixSize = sizeof (Allocator*);
+
+   /**
+    * The allocator of the values created outside of the runs of VirtualMachines, which any thread may create and release.
+    */
+   class SharedAllocator : public PoolAllocator {
+   public:
+      virtual void* allocate(size_t size) {
+         lock_guard<mutex> lock(mMutex);
+         return PoolAllocator::allocate(size);
+      }
+      virtual void deallocate(void* pBlock, size_t size) {
+         lock_guard<mutex> lock(mMutex);
+         PoolAllocator::deallocate(pBlock, size);
+      }
+      /**
+       * Containers shared by threads cannot be scanned while any of them may change them: they are never collected, and the
+       * containers of the VirtualMachines they reference are considered reachable.
+       */
+      virtual ContainerHeap* getContainers() {
+         return 0;
+      }
+
+   private:
+      mutex mMutex;
+   };
+
+   /**
+    * @return the process-wide allocator. It is never deleted, as values with static storage duration may be released after
+    * any other object is destroyed.
+    */
+   SharedAllocator& getShared() {
+      static SharedAllocator* pShared = new SharedAllocator();
+      return *pShared;
+   }
+
+   inline size_t roundUp(size_t size, size_t granularity) {
+      return (size + granularity - 1) & ~(granularity - 1);
+   }
+}
+
+Allocator::Allocator() : mOrphaned(false) {
+   memset(&mStatistics, 0, sizeof (mStatistics));
+}
+
+void Allocator::deleteWhenUnused() {
+   if (hasLiveBlocks())
+      mOrphaned = true;
+   else
+      delete this;
+}
+
+Allocator& Allocator::getCurrent() {
+   return tpCurrent ? *tpCurrent : getShared();
+}
+
+void* Allocator::allocateBlock(size_t size) {
+   Allocator& allocator = getCurrent();
+   char* pBlock = static_cast<char*> (allocator.allocate(size + kPrefixSize));
+   *reinterpret_cast<Allocator**> (pBlock) = &allocator;
+   return pBlock + kPrefixSize;
+}
+
+void Allocator::deallocateBlock(void* pBlock, size_t size) {
+   char* pPrefixed = static_cast<char*> (pBlock) - kPrefixSize;
+   Allocator* pAllocator = *reinterpret_cast<Allocator**> (pPrefixed);
+   pAllocator->deallocate(pPrefixed, size + kPrefixSize);
+   if (pAllocator->mOrphaned && !pAllocator->hasLiveBlocks())
+      delete pAllocator;
+}
+
+Allocator::Scope::Scope(Allocator* pAllocator) : mpPrevious(tpCurrent) {
+   if (pAllocator)
+      tpCurrent = pAllocator;
+}
+
+Allocator::Scope::~Scope() {
+   tpCurrent = mpPrevious;
+}
+
+//
+
+PoolAllocator::PoolAllocator() : mpChunkPosition(0), mpChunkEnd(0) {
+   memset(mFreeLists, 0, sizeof (mFreeLists));
+}
+
+PoolAllocator::~PoolAllocator() {
+   for (size_t i = 0; i < mChunks.size(); i++)
+      ::operator delete(mChunks[i]);
+}
+
+void* PoolAllocator::allocate(size_t size) {
+   countAllocation(size);
+   if (size > kMaxPooledSize) {
+      mStatistics.reservedBytes += size;
+      return ::operator new(size);
+   }
+
+   size_t blockSize = roundUp(size, kGranularity);
+   FreeBlock*& pFree = mFreeLists[blockSize / kGranularity - 1];
+   if (pFree) {
+      FreeBlock* pBlock = pFree;
+      pFree = pBlock->pNext;
+      return pBlock;
+   }
+
+   // the rest of a chunk too small for the block is left unused
+   if (mpChunkPosition + blockSize > mpChunkEnd) {
+      mChunks.push_back(static_cast<char*> (::operator new(kChunkSize)));
+      mpChunkPosition = mChunks.back();
+      mpChunkEnd = mpChunkPosition + kChunkSize;
+      mStatistics.reservedBytes += kChunkSize;
+   }
+   void* pBlock = mpChunkPosition;
+   mpChunkPosition += blockSize;
+   return pBlock;
+}
+
+void PoolAllocator::deallocate(void* pBlock, size_t size) {
+   countDeallocation(size);
+   if (size > kMaxPooledSize) {
+      mStatistics.reservedBytes -= size;
+      ::operator delete(pBlock);
+      return;
+   }
+
+   FreeBlock*& pFree = mFreeLists[roundUp(size, kGranularity) / kGranularity - 1];
+   FreeBlock* pFreed = static_cast<FreeBlock*> (pBlock);
+   pFreed->pNext = pFree;
+   pFree = pFreed;
+}
+
+//
+
+ArenaAllocator::ArenaAllocator() : mChunk(0), mpChunkPosition(0), mpChunkEnd(0) { }
+
+ArenaAllocator::~ArenaAllocator() {
+   for (size_t i = 0; i < mChunks.size(); i++)
+      ::operator delete(mChunks[i]);
+}
+
+void* ArenaAllocator::allocate(size_t size) {
+   countAllocation(size);
+   // blocks that would waste most of a chunk are allocated on their own
+   if (size > kChunkSize / 4) {
+      mStatistics.reservedBytes += size;
+      return ::operator new(size);
+   }
+
+   size_t blockSize = roundUp(size, PoolAllocator::kGranularity);
+   if (mpChunkPosition + blockSize > mpChunkEnd) {
+      if (mpChunkEnd)
+         mChunk++;
+      if (mChunk == mChunks.size()) {
+         mChunks.push_back(static_cast<char*> (::operator new(kChunkSize)));
+         mStatistics.reservedBytes += kChunkSize;
+      }
+      mpChunkPosition = mChunks[mChunk];
+      mpChunkEnd = mpChunkPosition + kChunkSize;
+   }
+   void* pBlock = mpChunkPosition;
+   mpChunkPosition += blockSize;
+   return pBlock;
+}
+
+void ArenaAllocator::deallocate(void* pBlock, size_t size) {
+   countDeallocation(size);
+   if (size > kChunkSize / 4) {
+      mStatistics.reservedBytes -= size;
+      ::operator delete(pBlock);
+   }
+}
+
+void ArenaAllocator::reset() {
+   if (hasLiveBlocks() || mChunks.empty())
+      return;
+   mChunk = 0;
+   mpChunkPosition = mChunks[0];
+   mpChunkEnd = mpChunkPosition + kChunkSize;
+}
@@ -0,0 +1,242 @@
+/*******************************************************************************
+ * IonScript                                                                   *
+ * (c) 2010-2011 Canio Massimo Tristano <massimo.tristano@gmail.com>           *
+ *                                                                             *
+ * This software is provided 'as-is', without any express or implied           *
+ * warranty. In no event will the authors be held liable for any damages       *
+ * arising from the use of this software.                                      *
+ *                                                                             *
+ * Permission is granted to anyone to use this software for any purpose,       *
+ * including commercial applications, and to alter it and redistribute it      *
+ * freely, subject to the following restrictions:                              *
+ *                                                                             *
+ * 1. The origin of this software must not be misrepresented; you must not     *
+ * claim that you wrote the original software. If you use this software        *
+ * in a product, an acknowledgment in the product documentation would be       *
+ * appreciated but is not required.                                            *
+ *                                                                             *
+ * 2. Altered source versions must be plainly marked as such, and must not be  *
+ * misrepresented as being the original software.                              *
+ *                                                                             *
+ * 3. This notice may not be removed or altered from any source                *
+ * distribution.                                                               *
+ ******************************************************************************/
+
+#ifndef ION_SCRIPT_ALLOCATOR_H
+#define	ION_SCRIPT_ALLOCATOR_H
+
+#include "Typedefs.h"
+
+#include <vector>
+#include <stddef.h>
+
+namespace ionscript {
+
+   class ContainerHeader;
+
+   /**
+    * The lists and dictionaries allocated by an Allocator, which the Collector scans for cycles, and the thresholds of their
+    * automatic collections.
+    */
+   struct ContainerHeap {
+      ContainerHeader* pFirst;
+      size_t containersCount;
+      /** Containers allocated since the last collection. */
+      size_t allocationsCount;
+      /** Allocations that trigger the next collection, 0 if automatic collections are disabled. */
+      size_t nextCollection;
+      size_t threshold;
+      double growth;
+      size_t collectionsCount;
+      size_t collectedCount;
+      bool collecting;
+
+      /**
+       * Constructs an empty heap with the default thresholds of the Collector.
+       */
+      ContainerHeap();
+   };
+
+   /**
+    * Counters kept by every Allocator.
+    */
+   struct AllocationStatistics {
+      /** Number of blocks allocated so far. */
+      size_t allocationsCount;
+      /** Number of blocks deallocated so far. */
+      size_t deallocationsCount;
+      /** Bytes of the blocks currently allocated. */
+      size_t liveBytes;
+      /** Highest value reached by liveBytes. */
+      size_t peakBytes;
+      /** Bytes obtained from the system, which the allocator hands out as blocks. */
+      size_t reservedBytes;
+   };
+
+   /**
+    * Allocates the heap values of scripts: the cells holding strings, lists, dictionaries and the headers of unmanaged objects.
+    * A VirtualMachine makes its allocator, a PoolAllocator of its own unless one is given with VirtualMachine::setAllocator(), the
+    * current one of the thread while it runs scripts. Values created by the host outside of any run come from a process-wide
+    * PoolAllocator guarded by a mutex. Blocks remember their allocator, so a value is released by the one that allocated it,
+    * whatever allocator is current at that time.
+    * @remark allocators are not thread-safe, except for the process-wide one: the values of an allocator must only be created and
+    *       released by one thread at a time, and it must outlive them (see deleteWhenUnused()).
+    */
+   class Allocator {
+   public:
+      Allocator();
+      virtual ~Allocator() { }
+
+      /**
+       * @return a block of at least given size, aligned for any value.
+       */
+      virtual void* allocate(size_t size) = 0;
+      /**
+       * Gives back a block returned by allocate().
+       * @param size the size the block was requested with.
+       */
+      virtual void deallocate(void* pBlock, size_t size) = 0;
+      /**
+       * Called by the VirtualMachine before each run, once the values of the previous one have been released. Allocators may
+       * recycle their memory wholesale at this point if no block is live anymore.
+       */
+      virtual void reset() { }
+      /**
+       * @return the counters of this allocator.
+       */
+      inline const AllocationStatistics& getStatistics() const {
+         return mStatistics;
+      }
+      /**
+       * @return the lists and dictionaries allocated by this allocator, 0 if the Collector does not track them.
+       */
+      virtual ContainerHeap* getContainers() {
+         return &mContainers;
+      }
+      /**
+       * Deletes this allocator, which must have been created by new, once none of its blocks is live anymore: right away, or
+       * when the last one is deallocated. Its owner calls it instead of deleting it when values may outlive the owner.
+       */
+      void deleteWhenUnused();
+
+      /**
+       * @return the current allocator of the calling thread, the process-wide one outside of the runs of VirtualMachines.
+       */
+      static Allocator& getCurrent();
+      /**
+       * Allocates a block with the current allocator of the calling thread, prefixed by the allocator that must free it.
+       */
+      static void* allocateBlock(size_t size);
+      /**
+       * Deallocates a block returned by allocateBlock() with its own allocator.
+       */
+      static void deallocateBlock(void* pBlock, size_t size);
+
+      /**
+       * Makes an allocator the current one of the thread for the lifetime of the scope, if given one.
+       */
+      class Scope {
+      public:
+         explicit Scope(Allocator* pAllocator);
+         ~Scope();
+      private:
+         Allocator* mpPrevious;
+
+         Scope(const Scope&);
+         Scope & operator=(const Scope&);
+      };
+
+   protected:
+      AllocationStatistics mStatistics;
+      ContainerHeap mContainers;
+
+      inline void countAllocation(size_t size) {
+         mStatistics.allocationsCount++;
+         mStatistics.liveBytes += size;
+         if (mStatistics.liveBytes > mStatistics.peakBytes)
+            mStatistics.peakBytes = mStatistics.liveBytes;
+      }
+      inline void countDeallocation(size_t size) {
+         mStatistics.deallocationsCount++;
+         mStatistics.liveBytes -= size;
+      }
+      inline bool hasLiveBlocks() const {
+         return mStatistics.allocationsCount != mStatistics.deallocationsCount;
+      }
+
+   private:
+      /** Whether deleteWhenUnused() was called while blocks were live. */
+      bool mOrphaned;
+
+      Allocator(const Allocator&);
+      Allocator & operator=(const Allocator&);
+   };
+
+   /**
+    * Allocator keeping a free list for each size class (multiples of 16 bytes up to kMaxPooledSize), carved out of large chunks: the
+    * cells of scripts come in a handful of sizes, so released blocks are reused as they are without going through operator new.
+    * Bigger blocks are allocated by operator new. Chunks are only given back to the system when the allocator is destroyed.
+    */
+   class PoolAllocator : public Allocator {
+   public:
+      static const size_t kGranularity = 16;
+      static const size_t kMaxPooledSize = 256;
+      static const size_t kChunkSize = 64 * 1024;
+
+      PoolAllocator();
+      virtual ~PoolAllocator();
+
+      virtual void* allocate(size_t size);
+      virtual void deallocate(void* pBlock, size_t size);
+
+   private:
+      struct FreeBlock {
+         FreeBlock* pNext;
+      };
+
+      FreeBlock* mFreeLists[kMaxPooledSize / kGranularity];
+      std::vector<char*> mChunks;
+      char* mpChunkPosition;
+      char* mpChunkEnd;
+   };
+
+   /**
+    * Allocator handing out blocks by bumping a pointer through chunks and not reusing released ones until reset() finds that no
+    * block is live anymore, when all the chunks are recycled at once: meant for VirtualMachines running one request script after
+    * the other, whose values all die with the run. Deallocating only counts. Blocks surviving a run (values kept by the host)
+    * postpone the recycling to the first reset() after they are released.
+    */
+   class ArenaAllocator : public Allocator {
+   public:
+      static const size_t kChunkSize = 256 * 1024;
+
+      ArenaAllocator();
+      virtual ~ArenaAllocator();
+
+      virtual void* allocate(size_t size);
+      virtual void deallocate(void* pBlock, size_t size);
+      virtual void reset();
+
+   private:
+      std::vector<char*> mChunks;
+      /** Index in mChunks of the chunk being filled. */
+      size_t mChunk;
+      char* mpChunkPosition;
+      char* mpChunkEnd;
+   };
+
+   /**
+    * Base of the objects allocated through the current Allocator of the thread.
+    */
+   class Allocated {
+   public:
+      static inline void* operator new(size_t size) {
+         return Allocator::allocateBlock(size);
+      }
+      static inline void operator delete(void* pBlock, size_t size) {
+         Allocator::deallocateBlock(pBlock, size);
+      }
+   };
+}
+
+#endif	/* ION_SCRIPT_ALLOCATOR_H */
@@ -0,0 +1,296 @@
+/*******************************************************************************
+ * IonScript                                                                   *
+ * (c) 2010-2011 Canio Massimo Tristano <massimo.tristano@gmail.com>           *
+ *                                                                             *
+ * This software is provided 'as-is', without any express or implied           *
+ * warranty. In no event will the authors be held liable for any damages       *
+ * arising from the use of this software.                                      *
+ *                                                                             *
+ * Permission is granted to anyone to use this software for any purpose,       *
+ * including commercial applications, and to alter it and redistribute it      *
+ * freely, subject to the following restrictions:                              *
+ *                                                                             *
+ * 1. The origin of this software must not be misrepresented; you must not     *
+ * claim that you wrote the original software. If you use this software        *
+ * in a product, an acknowledgment in the product documentation would be       *
+ * appreciated but is not required.                                            *
+ *                                                                             *
+ * 2. Altered source versions must be plainly marked as such, and must not be  *
+ * misrepresented as being the original software.                              *
+ *                                                                             *
+ * 3. This notice may not be removed or altered from any source                *
+ * distribution.                                                               *
+ ******************************************************************************/
+
+#include "Array.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+using namespace ionscript;
+
+const char Value::kArrayTypeName[] = "ionscript::Array";
+
+namespace {
+
+   inline size_t getElementSize(Array::ElementType elementType) {
+      return (elementType == Array::ELEMENT_FLOAT64) ? sizeof (double) : sizeof (int32_t);
+   }
+
+   /*
+    * Element loops, written once for every element type. Reductions keep four partial results so that consecutive additions do
+    * not wait for each other, float64 ones use SSE2 explicitly as the compiler may not reorder floating point additions.
+    */
+
+   template <typename T>
+   double sumElements(const T* pElements, size_t size) {
+      double partials[4] = {0, 0, 0, 0};
+      size_t i = 0;
+      for (; i + 4 <= size; i += 4)
+         for (size_t j = 0; j < 4; j++)
+            partials[j] += pElements[i + j];
+      for (; i < size; i++)
+         partials[0] += pElements[i];
+      return (partials[0] + partials[1]) + (partials[2] + partials[3]);
+   }
+
+   template <typename T, typename U>
+   double dotElements(const T* pLeft, const U* pRight, size_t size) {
+      double partials[4] = {0, 0, 0, 0};
+      size_t i = 0;
+      for (; i + 4 <= size; i += 4)
+         for (size_t j = 0; j < 4; j++)
+            partials[j] += (double) pLeft[i + j] * pRight[i + j];
+      for (; i < size; i++)
+         partials[0] += (double) pLeft[i] * pRight[i];
+      return (partials[0] + partials[1]) + (partials[2] + partials[3]);
+   }
+
+   template <typename T>
+   double minElement(const T* pElements, size_t size) {
+      return *min_element(pElements, pElements + size);
+   }
+
+   template <typename T>
+   double maxElement(const T* pElements, size_t size) {
+      return *max_element(pElements, pElements + size);
+   }
+
+#ifdef __SSE2__
+
+   inline double addHalves(__m128d pair) {
+      return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+   }
+
+   template <>
+   double sumElements(const double* pElements, size_t size) {
+      __m128d first = _mm_setzero_pd(), second = _mm_setzero_pd();
+      size_t i = 0;
+      for (; i + 4 <= size; i += 4) {
+         first = _mm_add_pd(first, _mm_loadu_pd(pElements + i));
+         second = _mm_add_pd(second, _mm_loadu_pd(pElements + i + 2));
+      }
+      double sum = addHalves(_mm_add_pd(first, second));
+      for (; i < size; i++)
+         sum += pElements[i];
+      return sum;
+   }
+
+   template <>
+   double dotElements(const double* pLeft, const double* pRight, size_t size) {
+      __m128d first = _mm_setzero_pd(), second = _mm_setzero_pd();
+      size_t i = 0;
+      for (; i + 4 <= size; i += 4) {
+         first = _mm_add_pd(first, _mm_mul_pd(_mm_loadu_pd(pLeft + i), _mm_loadu_pd(pRight + i)));
+         second = _mm_add_pd(second, _mm_mul_pd(_mm_loadu_pd(pLeft + i + 2), _mm_loadu_pd(pRight + i + 2)));
+      }
+      double dot = addHalves(_mm_add_pd(first, second));
+      for (; i < size; i++)
+         dot += pLeft[i] * pRight[i];
+      return dot;
+   }
+
+   template <>
+   double minElement(const double* pElements, size_t size) {
+      if (size < 2)
+         return pElements[0];
+      __m128d least = _mm_loadu_pd(pElements);
+      size_t i = 2;
+      for (; i + 2 <= size; i += 2)
+         least = _mm_min_pd(least, _mm_loadu_pd(pElements + i));
+      least = _mm_min_sd(least, _mm_unpackhi_pd(least, least));
+      double result = _mm_cvtsd_f64(least);
+      return (i < size) ? std::min(result, pElements[i]) : result;
+   }
+
+   template <>
+   double maxElement(const double* pElements, size_t size) {
+      if (size < 2)
+         return pElements[0];
+      __m128d greatest = _mm_loadu_pd(pElements);
+      size_t i = 2;
+      for (; i + 2 <= size; i += 2)
+         greatest = _mm_max_pd(greatest, _mm_loadu_pd(pElements + i));
+      greatest = _mm_max_sd(greatest, _mm_unpackhi_pd(greatest, greatest));
+      double result = _mm_cvtsd_f64(greatest);
+      return (i < size) ? std::max(result, pElements[i]) : result;
+   }
+#endif
+
+   // element-wise loops are vectorized by the compiler
+   template <typename T>
+   void scaleElements(T* pElements, size_t size, T factor) {
+      for (size_t i = 0; i < size; i++)
+         pElements[i] *= factor;
+   }
+
+   template <typename T, typename U>
+   void accumulateElements(T* pTarget, const U* pSource, size_t size, T factor) {
+      for (size_t i = 0; i < size; i++)
+         pTarget[i] += factor * pSource[i];
+   }
+
+   /*
+    * int32 loops compute in int64, which holds any product of two int32 values plus a third one. The results are checked in a
+    * first pass, so an overflow raises a RuntimeError before any element is changed.
+    */
+
+   inline void checkInt32Range(int64_t least, int64_t greatest) {
+      if (least < INT32_MIN || greatest > INT32_MAX)
+         throw RuntimeError("the result overflows the int32 elements.");
+   }
+
+   template <>
+   void scaleElements(int32_t* pElements, size_t size, int32_t factor) {
+      int64_t least = 0, greatest = 0;
+      for (size_t i = 0; i < size; i++) {
+         int64_t result = (int64_t) pElements[i] * factor;
+         least = std::min(least, result);
+         greatest = std::max(greatest, result);
+      }
+      checkInt32Range(least, greatest);
+      for (size_t i = 0; i < size; i++)
+         pElements[i] = (int32_t) ((int64_t) pElements[i] * factor);
+   }
+
+   template <>
+   void accumulateElements(int32_t* pTarget, const int32_t* pSource, size_t size, int32_t factor) {
+      int64_t least = 0, greatest = 0;
+      for (size_t i = 0; i < size; i++) {
+         int64_t result = pTarget[i] + (int64_t) factor * pSource[i];
+         least = std::min(least, result);
+         greatest = std::max(greatest, result);
+      }
+      checkInt32Range(least, greatest);
+      for (size_t i = 0; i < size; i++)
+         pTarget[i] = (int32_t) (pTarget[i] + (int64_t) factor * pSource[i]);
+   }
+}
+
+Array::Array(ElementType elementType, size_t size)
+: ValueHeader(this, Value::kArrayTypeName, true), mElementType(elementType), mSize(size), mOwned(true) {
+   mpElements = Allocator::allocateBlock(size * getElementSize(elementType));
+   memset(mpElements, 0, size * getElementSize(elementType));
+}
+
+Array::Array(double* pElements, size_t size)
+: ValueHeader(this, Value::kArrayTypeName, true), mElementType(ELEMENT_FLOAT64), mSize(size), mpElements(pElements),
+mOwned(false) { }
+
+Array::Array(int32_t* pElements, size_t size)
+: ValueHeader(this, Value::kArrayTypeName, true), mElementType(ELEMENT_INT32), mSize(size), mpElements(pElements),
+mOwned(false) { }
+
+Array::~Array() {
+   if (mOwned)
+      Allocator::deallocateBlock(mpElements, mSize * getElementSize(mElementType));
+}
+
+double Array::get(const Value& index) const {
+   return get(checkIndex(index));
+}
+
+void Array::set(const Value& index, const Value& number) {
+   set(checkIndex(index), number.getNumberSafely());
+}
+
+double Array::sum() const {
+   if (mElementType == ELEMENT_FLOAT64)
+      return sumElements(getFloat64Elements(), mSize);
+   return sumElements(getInt32Elements(), mSize);
+}
+
+double Array::dot(const Array& other) const {
+   checkSameSize(other);
+   if (mElementType == ELEMENT_FLOAT64) {
+      if (other.mElementType == ELEMENT_FLOAT64)
+         return dotElements(getFloat64Elements(), other.getFloat64Elements(), mSize);
+      return dotElements(getFloat64Elements(), other.getInt32Elements(), mSize);
+   }
+   if (other.mElementType == ELEMENT_FLOAT64)
+      return dotElements(other.getFloat64Elements(), getInt32Elements(), mSize);
+   return dotElements(getInt32Elements(), other.getInt32Elements(), mSize);
+}
+
+void Array::scale(double factor) {
+   if (mElementType == ELEMENT_FLOAT64)
+      scaleElements(getFloat64Elements(), mSize, factor);
+   else if (isInt32(factor))
+      scaleElements(getInt32Elements(), mSize, (int32_t) factor);
+   else
+      throw RuntimeError("an int32 array can only be scaled by an int32 integer.");
+}
+
+void Array::accumulate(const Array& other, double factor) {
+   checkSameSize(other);
+   if (mElementType == ELEMENT_FLOAT64) {
+      if (other.mElementType == ELEMENT_FLOAT64)
+         accumulateElements(getFloat64Elements(), other.getFloat64Elements(), mSize, factor);
+      else
+         accumulateElements(getFloat64Elements(), other.getInt32Elements(), mSize, factor);
+   } else if (other.mElementType == ELEMENT_INT32 && isInt32(factor))
+      accumulateElements(getInt32Elements(), other.getInt32Elements(), mSize, (int32_t) factor);
+   else
+      throw RuntimeError("an int32 array can only accumulate an int32 array multiplied by an int32 integer.");
+}
+
+double Array::min() const {
+   if (mSize == 0)
+      throw RuntimeError("cannot find the minimum of an empty array.");
+   if (mElementType == ELEMENT_FLOAT64)
+      return minElement(getFloat64Elements(), mSize);
+   return minElement(getInt32Elements(), mSize);
+}
+
+double Array::max() const {
+   if (mSize == 0)
+      throw RuntimeError("cannot find the maximum of an empty array.");
+   if (mElementType == ELEMENT_FLOAT64)
+      return maxElement(getFloat64Elements(), mSize);
+   return maxElement(getInt32Elements(), mSize);
+}
+
+Array* Array::slice(size_t begin, size_t end) const {
+   Array* pSlice = new Array(mElementType, end - begin);
+   size_t elementSize = getElementSize(mElementType);
+   memcpy(pSlice->mpElements, static_cast<char*> (mpElements) + begin * elementSize, (end - begin) * elementSize);
+   return pSlice;
+}
+
+size_t Array::checkIndex(const Value& index) const {
+   index.assertIsPositiveInteger();
+   size_t i = static_cast<size_t> (index.getNumber());
+   if (i >= mSize)
+      throw RuntimeError("index out of array boundaries.");
+   return i;
+}
+
+void Array::checkSameSize(const Array& other) const {
+   if (mSize != other.mSize)
+      throw RuntimeError("the arrays must have the same size.");
+}
@@ -0,0 +1,173 @@
+/*******************************************************************************
+ * IonScript                                                                   *
+ * (c) 2010-2011 Canio Massimo Tristano <massimo.tristano@gmail.com>           *
+ *                                                                             *
+ * This software is provided 'as-is', without any express or implied           *
+ * warranty. In no event will the authors be held liable for any damages       *
+ * arising from the use of this software.                                      *
+ *                                                                             *
+ * Permission is granted to anyone to use this software for any purpose,       *
+ * including commercial applications, and to alter it and redistribute it      *
+ * freely, subject to the following restrictions:                              *
+ *                                                                             *
+ * 1. The origin of this software must not be misrepresented; you must not     *
+ * claim that you wrote the original software. If you use this software        *
+ * in a product, an acknowledgment in the product documentation would be       *
+ * appreciated but is not required.                                            *
+ *                                                                             *
+ * 2. Altered source versions must be plainly marked as such, and must not be  *
+ * misrepresented as being the original software.                              *
+ *                                                                             *
+ * 3. This notice may not be removed or altered from any source                *
+ * distribution.                                                               *
+ ******************************************************************************/
+
+#ifndef ION_SCRIPT_ARRAY_H
+#define	ION_SCRIPT_ARRAY_H
+
+#include "Allocator.h"
+#include "Exceptions.h"
+#include "Typedefs.h"
+#include "Value.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ionscript {
+
+   /**
+    * A typed array: numbers packed as raw float64 or int32 elements instead of Values, created by the float64() and int32()
+    * builtins. For scripts it is an object (TYPE_OBJECT) that the VirtualMachine indexes, sets and measures natively like a list,
+    * and that the numeric builtins (sum, dot, scale, accumulate, min, max) process in vectorized loops.
+    * The array is its own ValueHeader. It either owns its elements, allocated by the current Allocator, or refers to host memory
+    * without copying it, which the host must keep alive as long as scripts can reach the array.
+    */
+   class Array : public ValueHeader, public Allocated {
+   public:
+
+      /**
+       * The types elements can have.
+       */
+      enum ElementType {
+         ELEMENT_FLOAT64,
+         ELEMENT_INT32
+      };
+
+      /**
+       * Constructs an array owning given number of elements, all zero.
+       */
+      Array(ElementType elementType, size_t size);
+      /**
+       * Constructs an array over given host numbers, which are neither copied nor deleted.
+       */
+      Array(double* pElements, size_t size);
+      /**
+       * Constructs an array over given host integers, which are neither copied nor deleted.
+       */
+      Array(int32_t* pElements, size_t size);
+      virtual ~Array();
+
+      inline ElementType getElementType() const {
+         return mElementType;
+      }
+      inline size_t getSize() const {
+         return mSize;
+      }
+      /**
+       * @return the elements of a float64 array.
+       */
+      inline double* getFloat64Elements() const {
+         return static_cast<double*> (mpElements);
+      }
+      /**
+       * @return the elements of an int32 array.
+       */
+      inline int32_t* getInt32Elements() const {
+         return static_cast<int32_t*> (mpElements);
+      }
+      /**
+       * @return the element at given index as a number.
+       * @remark it does not check the index for efficiency.
+       */
+      inline double get(size_t index) const {
+         return (mElementType == ELEMENT_FLOAT64) ? getFloat64Elements()[index] : getInt32Elements()[index];
+      }
+      /**
+       * Sets the element at given index, which must be an integer in int32 arrays.
+       * @remark it does not check the index for efficiency.
+       */
+      inline void set(size_t index, double number) {
+         if (mElementType == ELEMENT_FLOAT64)
+            getFloat64Elements()[index] = number;
+         else if (isInt32(number))
+            getInt32Elements()[index] = (int32_t) number;
+         else
+            throw RuntimeError("int32 array elements must be integers within the int32 range.");
+      }
+      /**
+       * @return the element indexed by given value.
+       * @remark it checks the index and throws a RuntimeError if it is not a positive integer within the array.
+       */
+      double get(const Value& index) const;
+      /**
+       * Sets the element indexed by given value to given number.
+       * @remark it checks both values and throws a RuntimeError if they are incorrect.
+       */
+      void set(const Value& index, const Value& number);
+
+      /**
+       * @return the sum of the elements.
+       */
+      double sum() const;
+      /**
+       * @return the sum of the products of the elements of this array and given one, which must have the same size.
+       */
+      double dot(const Array& other) const;
+      /**
+       * Multiplies every element by given factor.
+       * @remark it throws a RuntimeError, leaving the array unchanged, if a result does not fit an int32 element.
+       */
+      void scale(double factor);
+      /**
+       * Adds the elements of given array, which must have the same size, multiplied by given factor to the elements of this one.
+       * @remark it throws a RuntimeError, leaving the array unchanged, if a result does not fit an int32 element.
+       */
+      void accumulate(const Array& other, double factor);
+      /**
+       * @return the smallest element.
+       * @remark it throws a RuntimeError if the array is empty.
+       */
+      double min() const;
+      /**
+       * @return the largest element.
+       * @remark it throws a RuntimeError if the array is empty.
+       */
+      double max() const;
+      /**
+       * @return a new array with the same element type holding the elements from index begin up to index end excluded.
+       */
+      Array* slice(size_t begin, size_t end) const;
+
+   private:
+      ElementType mElementType;
+      size_t mSize;
+      void* mpElements;
+      /** Whether the elements were allocated by this array, rather than given by the host. */
+      bool mOwned;
+
+      /**
+       * @return whether given number is an integer that an int32 element can hold. The range is checked first, as converting
+       * a number out of it to int32_t is undefined.
+       */
+      static inline bool isInt32(double number) {
+         return number >= INT32_MIN && number <= INT32_MAX && number == (int32_t) number;
+      }
+      size_t checkIndex(const Value& index) const;
+      void checkSameSize(const Array& other) const;
+
+      Array(const Array&);
+      Array & operator=(const Array&);
+   };
+}
+
+#endif	/* ION_SCRIPT_ARRAY_H */
@@ -0,0 +1,507 @@
+/*******************************************************************************
+ * IonScript                                                                   *
+ * (c) 2010-2011 Canio Massimo Tristano <massimo.tristano@gmail.com>           *
+ *                                                                             *
+ * This software is provided 'as-is', without any express or implied           *
+ * warranty. In no event will the authors be held liable for any damages       *
+ * arising from the use of this software.                                      *
+ *                                                                             *
+ * Permission is granted to anyone to use this software for any purpose,       *
+ * including commercial applications, and to alter it and redistribute it      *
+ * freely, subject to the following restrictions:                              *
+ *                                                                             *
+ * 1. The origin of this software must not be misrepresented; you must not     *
+ * claim that you wrote the original software. If you use this software        *
+ * in a product, an acknowledgment in the product documentation would be       *
+ * appreciated but is not required.                                            *
+ *                                                                             *
+ * 2. Altered source versions must be plainly marked as such, and must not be  *
+ * misrepresented as being the original software.                              *
+ *                                                                             *
+ * 3. This notice may not be removed or altered from any source                *
+ * distribution.                                                               *
+ ******************************************************************************/
+
+#include "VirtualMachine.h"
+#include "Array.h"
+#include "Exceptions.h"
+#include "Dictionary.h"
+
+#include <vector>
+#include <utility>
+#include <cmath>
+#include <algorithm>
+
+using namespace ionscript;
+using namespace std;
+
+/*
+ * The builtin functions live apart from the dispatch loop so that they do not take up the inlining budget GCC grants to
+ * the translation unit of VirtualMachine::execute().
+ */
+
+enum
+{
+	BFID_PRINT,
+	BFID_POST,
+	BFID_GET,
+	BFID_LEN,
+	BFID_APPEND,
+	BFID_REMOVE,
+	BFID_ASSERT,
+	BFID_DUMP,
+	BFID_STR,
+	BFID_JOIN,
+	BFID_ERROR,
+	BFID_FLOOR,
+	BFID_SQRT,
+	BFID_ABS,
+	BFID_MIN,
+	BFID_MAX,
+	BFID_POW,
+	BFID_SUBSTR,
+	BFID_FIND,
+	BFID_SPLIT,
+	BFID_REPLACE,
+	BFID_KEYS,
+	BFID_VALUES,
+	BFID_RANGE,
+	BFID_SORT,
+	BFID_COLLECT,
+	BFID_RESERVE,
+	BFID_CAPACITY,
+	BFID_POP,
+	BFID_FLOAT64,
+	BFID_INT32,
+	BFID_SUM,
+	BFID_DOT,
+	BFID_SCALE,
+	BFID_ACCUMULATE,
+};
+
+void VirtualMachine::registerBuiltins()
+{
+	HostFunctionGroupID hfgID = registerHostFunctionGroup(builtinsGroup);
+	setFunction("print", hfgID, BFID_PRINT, 0, -1);
+	setFunction("post", hfgID, BFID_POST, 2);
+	setFunction("get", hfgID, BFID_GET, 1);
+	setFunction("len", hfgID, BFID_LEN, 1);
+	setFunction("append", hfgID, BFID_APPEND, 2);
+	setFunction("remove", hfgID, BFID_REMOVE, 2);
+	setFunction("assert", hfgID, BFID_ASSERT, 1, 2);
+	setFunction("dump", hfgID, BFID_DUMP); // no arguments
+	setFunction("str", hfgID, BFID_STR, 1);
+	setFunction("join", hfgID, BFID_JOIN, 2, -1);
+	setFunction("error", hfgID, BFID_ERROR, 1);
+	setFunction("floor", hfgID, BFID_FLOOR, 1);
+	setFunction("sqrt", hfgID, BFID_SQRT, 1);
+	setFunction("abs", hfgID, BFID_ABS, 1);
+	setFunction("min", hfgID, BFID_MIN, 1, -1);
+	setFunction("max", hfgID, BFID_MAX, 1, -1);
+	setFunction("pow", hfgID, BFID_POW, 2);
+	setFunction("substr", hfgID, BFID_SUBSTR, 2, 3);
+	setFunction("find", hfgID, BFID_FIND, 2, 3);
+	setFunction("split", hfgID, BFID_SPLIT, 2);
+	setFunction("replace", hfgID, BFID_REPLACE, 3);
+	setFunction("keys", hfgID, BFID_KEYS, 1);
+	setFunction("values", hfgID, BFID_VALUES, 1);
+	setFunction("range", hfgID, BFID_RANGE, 1, 3);
+	setFunction("sort", hfgID, BFID_SORT, 1);
+	setFunction("collect", hfgID, BFID_COLLECT); // no arguments
+	setFunction("reserve", hfgID, BFID_RESERVE, 2);
+	setFunction("capacity", hfgID, BFID_CAPACITY, 1);
+	setFunction("pop", hfgID, BFID_POP, 1);
+	setFunction("float64", hfgID, BFID_FLOAT64, 1);
+	setFunction("int32", hfgID, BFID_INT32, 1);
+	setFunction("sum", hfgID, BFID_SUM, 1);
+	setFunction("dot", hfgID, BFID_DOT, 2);
+	setFunction("scale", hfgID, BFID_SCALE, 2);
+	setFunction("accumulate", hfgID, BFID_ACCUMULATE, 2, 3);
+
+	// the hottest builtins are compiled to dedicated instructions, min and max only when given two arguments
+	setIntrinsic("len", OP_LEN);
+	setIntrinsic("append", OP_APPEND);
+	setIntrinsic("floor", OP_FLOOR);
+	setIntrinsic("sqrt", OP_SQRT);
+	setIntrinsic("abs", OP_ABS);
+	setIntrinsic("min", OP_MIN);
+	setIntrinsic("max", OP_MAX);
+}
+
+void VirtualMachine::builtinsGroup(const FunctionCallManager & manager)
+{
+	switch (manager.getFunctionID())
+	{
+		case BFID_PRINT:
+			for (size_t i = 0; i < manager.getArgumentsCount(); i++)
+			{
+				cout << manager.getArgument(i).toString();
+				if (i != manager.getArgumentsCount() - 1)
+					cout << " ";
+			}
+			cout << endl;
+			manager.returnNil();
+			return;
+
+		case BFID_POST:
+			manager.assertArgumentType(0, Value::TYPE_STRING);
+			manager.mVM.mGlobalVariables[manager.getArgument(0).getString()] = manager.getArgument(1);
+			manager.returnValue(manager.getArgument(1));
+			return;
+
+		case BFID_GET:
+		{
+			manager.assertArgumentType(0, Value::TYPE_STRING);
+			map<string, Value>::iterator it = manager.mVM.mGlobalVariables.find(manager.getArgument(0).getString());
+			if (it == manager.mVM.mGlobalVariables.end())
+				manager.returnNil();
+			else
+				manager.returnValue(it->second);
+			return;
+		}
+
+		case BFID_LEN:
+			manager.assertArgumentType(0, Value::TYPE_STRING | Value::TYPE_LIST | Value::TYPE_DICTIONARY | Value::TYPE_OBJECT);
+			switch (manager.getArgument(0).getType())
+			{
+				case Value::TYPE_STRING:
+					manager.returnNumber(manager.getArgument(0).getString().size());
+					return;
+				case Value::TYPE_LIST:
+					manager.returnNumber(manager.getArgument(0).getListSize());
+					return;
+				case Value::TYPE_DICTIONARY:
+					manager.returnNumber(manager.getArgument(0).getDictionary().size());
+					return;
+				case Value::TYPE_OBJECT:
+					manager.returnNumber(manager.getArgument(0).getArraySafely().getSize());
+					return;
+				default: // Never executed
+					return;
+			}
+
+
+		case BFID_APPEND:
+			manager.assertArgumentType(0, Value::TYPE_LIST);
+			manager.getArgument(0).getList().push_back(manager.getArgument(1));
+			manager.returnValue(manager.getArgument(0));
+			return;
+
+		case BFID_REMOVE:
+			manager.assertArgumentType(0, Value::TYPE_LIST);
+			manager.assertArgumentType(1, Value::TYPE_NUMBER);
+			if (!manager.getArgument(1).isInteger() || manager.getArgument(1).getNumber() < 0)
+				throw RuntimeError("the index of the element to remove must be a positive integer.");
+			manager.getArgument(0).getList().erase(manager.getArgument(0).getList().begin() + static_cast<size_t> (manager.getArgument(1).getNumber()));
+			manager.returnValue(manager.getArgument(0));
+			return;
+
+		case BFID_ASSERT:
+			if (!manager.getArgument(0).toBoolean())
+			{
+				if (manager.getArgumentsCount() == 2)
+				{
+					manager.assertArgumentType(1, Value::TYPE_STRING);
+					throw RuntimeError("user assertion failed: " + manager.getArgument(1).getString() + ".");
+				} else
+					throw RuntimeError("user assertion failed.");
+			}
+			manager.returnNil();
+			return;
+
+		case BFID_DUMP:
+			manager.mVM.dump(std::cout);
+			manager.returnNil();
+			return;
+
+		case BFID_STR:
+			manager.returnString(manager.getArgument(0).toString());
+			return;
+
+		case BFID_JOIN:
+		{
+			manager.assertArgumentType(0, Value::TYPE_STRING);
+			string result = "";
+			const string& separator = manager.getArgument(0).getString();
+			if (manager.getArgument(1).isList())
+			{
+				const Value& list = manager.getArgument(1);
+				for (size_t i = 0; i < list.getListSize(); i++)
+				{
+					result += list.readListElement(i).toString();
+					if (i != list.getListSize() - 1)
+						result += separator;
+				}
+			} else
+			{
+				for (size_t i = 1; i < manager.getArgumentsCount(); i++)
+				{
+					result += manager.getArgument(i).toString();
+					if (i != manager.getArgumentsCount() - 1)
+						result += separator;
+				}
+			}
+			manager.returnString(result);
+			return;
+		}
+
+		case BFID_ERROR:
+			manager.assertArgumentType(0, Value::TYPE_STRING);
+			throw RuntimeError(manager.getArgument(0).getString());
+			return;
+
+		case BFID_FLOOR:
+			manager.returnNumber(floor(manager.getArgument(0).getNumberSafely()));
+			return;
+
+		case BFID_SQRT:
+			manager.returnNumber(sqrt(manager.getArgument(0).getNumberSafely()));
+			return;
+
+		case BFID_ABS:
+			manager.returnNumber(fabs(manager.getArgument(0).getNumberSafely()));
+			return;
+
+		case BFID_MIN:
+		case BFID_MAX:
+		{
+			// either min(list), min(array) or min(first, second, ...)
+			const Value* values = &manager.getArgument(0);
+			size_t count = manager.getArgumentsCount();
+			if (count == 1 && values[0].isArray())
+			{
+				const Array& array = values[0].getArray();
+				manager.returnNumber((manager.getFunctionID() == BFID_MIN) ? array.min() : array.max());
+				return;
+			}
+			if (count == 1 && values[0].isList())
+			{
+				const Value& list = values[0];
+				count = list.getListSize();
+				if (count == 0)
+					throw RuntimeError("cannot find the extreme of an empty list.");
+				values = &list.readListElement(0);
+			}
+
+			double result = values[0].getNumberSafely();
+			for (size_t i = 1; i < count; i++)
+			{
+				double number = values[i].getNumberSafely();
+				if ((manager.getFunctionID() == BFID_MIN) ? number < result : number > result)
+					result = number;
+			}
+			manager.returnNumber(result);
+			return;
+		}
+
+		case BFID_POW:
+			manager.returnNumber(pow(manager.getArgument(0).getNumberSafely(), manager.getArgument(1).getNumberSafely()));
+			return;
+
+		case BFID_SUBSTR:
+		{
+			const string& s = manager.getArgument(0).getStringSafely();
+			size_t start = manager.getArgument(1).getPositiveIntegerSafely();
+			if (start > s.size())
+				throw RuntimeError("substring start out of string boundaries.");
+			size_t count = (manager.getArgumentsCount() == 3) ? manager.getArgument(2).getPositiveIntegerSafely() : string::npos;
+			manager.returnString(s.substr(start, count));
+			return;
+		}
+
+		case BFID_FIND:
+		{
+			const string& s = manager.getArgument(0).getStringSafely();
+			const string& what = manager.getArgument(1).getStringSafely();
+			size_t from = (manager.getArgumentsCount() == 3) ? manager.getArgument(2).getPositiveIntegerSafely() : 0;
+			size_t position = s.find(what, from);
+			manager.returnNumber((position == string::npos) ? -1 : (double) position);
+			return;
+		}
+
+		case BFID_SPLIT:
+		{
+			const string& s = manager.getArgument(0).getStringSafely();
+			const string& separator = manager.getArgument(1).getStringSafely();
+			if (separator.empty())
+				throw RuntimeError("the separator to split a string by cannot be empty.");
+
+			Value result;
+			List& list = result.setEmptyList();
+			size_t begin = 0, end;
+			while ((end = s.find(separator, begin)) != string::npos)
+			{
+				list.push_back(Value(s.substr(begin, end - begin)));
+				begin = end + separator.size();
+			}
+			list.push_back(Value(s.substr(begin)));
+			manager.returnValue(result);
+			return;
+		}
+
+		case BFID_REPLACE:
+		{
+			const string& s = manager.getArgument(0).getStringSafely();
+			const string& what = manager.getArgument(1).getStringSafely();
+			const string& with = manager.getArgument(2).getStringSafely();
+			if (what.empty())
+				throw RuntimeError("the string to replace cannot be empty.");
+
+			string result;
+			size_t begin = 0, end;
+			while ((end = s.find(what, begin)) != string::npos)
+			{
+				result.append(s, begin, end - begin);
+				result += with;
+				begin = end + what.size();
+			}
+			result.append(s, begin, string::npos);
+			manager.returnString(result);
+			return;
+		}
+
+		case BFID_KEYS:
+		case BFID_VALUES:
+		{
+			manager.assertArgumentType(0, Value::TYPE_DICTIONARY);
+			const Dictionary& dictionary = manager.getArgument(0).getDictionary();
+
+			Value result;
+			List& list = result.setEmptyList();
+			list.reserve(dictionary.size());
+			for (Dictionary::const_iterator it = dictionary.begin(); it != dictionary.end(); ++it)
+				list.push_back((manager.getFunctionID() == BFID_KEYS) ? it->first : it->second);
+			manager.returnValue(result);
+			return;
+		}
+
+		case BFID_RANGE:
+		{
+			// range(end), range(begin, end) or range(begin, end, step)
+			double begin = 0, end, step = 1;
+			if (manager.getArgumentsCount() == 1)
+				end = manager.getArgument(0).getNumberSafely();
+			else
+			{
+				begin = manager.getArgument(0).getNumberSafely();
+				end = manager.getArgument(1).getNumberSafely();
+				if (manager.getArgumentsCount() == 3)
+					step = manager.getArgument(2).getNumberSafely();
+			}
+			if (!isfinite(begin) || !isfinite(end) || !isfinite(step))
+				throw RuntimeError("the bounds and the step of a range must be finite.");
+			if (step == 0)
+				throw RuntimeError("the step of a range cannot be zero.");
+
+			Value result;
+			List& list = result.setEmptyList();
+			double count = ceil((end - begin) / step);
+			if (count > 0)
+			{
+				// the count is converted to size_t below, which is undefined past its range
+				if (count >= static_cast<double> (list.max_size()))
+					throw RuntimeError("the range is too large.");
+				list.reserve(static_cast<size_t> (count));
+				for (size_t i = 0; i < count; i++)
+					list.push_back(Value(begin + i * step));
+			}
+			manager.returnValue(result);
+			return;
+		}
+
+		case BFID_SORT:
+		{
+			manager.assertArgumentType(0, Value::TYPE_LIST);
+			List& list = manager.getArgument(0).getList();
+
+			// std::sort needs a strict weak ordering: the elements are all numbers other than NaN, or all strings
+			if (!list.empty())
+			{
+				Value::Type type = list[0].getType();
+				if (type != Value::TYPE_NUMBER && type != Value::TYPE_STRING)
+					throw RuntimeError("only lists of numbers or of strings can be sorted.");
+				for (size_t i = 0; i < list.size(); i++)
+				{
+					if (list[i].getType() != type)
+						throw RuntimeError("cannot sort a list mixing values of different types.");
+					if (type == Value::TYPE_NUMBER && list[i].getNumber() != list[i].getNumber())
+						throw RuntimeError("cannot sort a list holding NaN.");
+				}
+			}
+			sort(list.begin(), list.end());
+			manager.returnValue(manager.getArgument(0));
+			return;
+		}
+
+		case BFID_COLLECT:
+			manager.returnNumber(Collector::collect());
+			return;
+
+		case BFID_RESERVE:
+			manager.assertArgumentType(0, Value::TYPE_LIST);
+			manager.getArgument(0).getList().reserve(manager.getArgument(1).getPositiveIntegerSafely());
+			manager.returnValue(manager.getArgument(0));
+			return;
+
+		case BFID_CAPACITY:
+			manager.assertArgumentType(0, Value::TYPE_LIST);
+			manager.returnNumber(manager.getArgument(0).getList().capacity());
+			return;
+
+		case BFID_POP:
+		{
+			manager.assertArgumentType(0, Value::TYPE_LIST);
+			List& list = manager.getArgument(0).getList();
+			if (list.empty())
+				throw RuntimeError("cannot pop from an empty list.");
+			Value last = list.back();
+			list.pop_back();
+			manager.returnValue(last);
+			return;
+		}
+
+		case BFID_FLOAT64:
+		case BFID_INT32:
+		{
+			// float64(size) and int32(size) are filled with zeros, float64(list) and int32(list) with the numbers of the list
+			Array::ElementType elementType = (manager.getFunctionID() == BFID_FLOAT64) ? Array::ELEMENT_FLOAT64 : Array::ELEMENT_INT32;
+			const Value& argument = manager.getArgument(0);
+			if (!argument.isList())
+			{
+				manager.returnValue(Value(new Array(elementType, argument.getPositiveIntegerSafely())));
+				return;
+			}
+
+			Value result(new Array(elementType, argument.getListSize()));
+			for (size_t i = 0; i < argument.getListSize(); i++)
+				result.getArray().set(i, argument.readListElement(i).getNumberSafely());
+			manager.returnValue(result);
+			return;
+		}
+
+		case BFID_SUM:
+			manager.returnNumber(manager.getArgument(0).getArraySafely().sum());
+			return;
+
+		case BFID_DOT:
+			manager.returnNumber(manager.getArgument(0).getArraySafely().dot(manager.getArgument(1).getArraySafely()));
+			return;
+
+		case BFID_SCALE:
+			manager.getArgument(0).getArraySafely().scale(manager.getArgument(1).getNumberSafely());
+			manager.returnValue(manager.getArgument(0));
+			return;
+
+		case BFID_ACCUMULATE:
+		{
+			// accumulate(target, source) or accumulate(target, source, factor)
+			double factor = (manager.getArgumentsCount() == 3) ? manager.getArgument(2).getNumberSafely() : 1;
+			manager.getArgument(0).getArraySafely().accumulate(manager.getArgument(1).getArraySafely(), factor);
+			manager.returnValue(manager.getArgument(0));
+			return;
+		}
+
+		default:
+			manager.returnNil();
+	}
+}
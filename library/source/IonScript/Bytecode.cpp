@@ -118,7 +118,9 @@ BytecodeWriter & BytecodeWriter::operator<<(bool data) {
 BytecodeReader::BytecodeReader(char* output) {
    mOutput = output;
    mPosition = sizeof (unsigned int) * 2;
-   *this >> mSize;
+   index_t size;
+   *this >> size;
+   mSize = size;
    mPosition = 0;
 }
 
@@ -131,7 +133,7 @@ void BytecodeReader::print(std::ostream& outStream) {
    mPosition = 0;
 
    unsigned int magicNumber, version;
-   size_t size;
+   index_t size;
    *this >> magicNumber >> version >> size;
    outStream << "IonScript Bytecode\nVersion: " << version << "\nSize: " << size << "\nInstructions:\n";
 
@@ -159,14 +161,6 @@ void BytecodeReader::print(std::ostream& outStream) {
             outStream << "push";
             break;
 
-         case OP_PUSH_VAL: //push.val
-         {
-            location_t loc;
-            (*this) >> loc;
-            outStream << "push.val " << (int) loc;
-            break;
-         }
-
          case OP_POP: // pop
             outStream << "pop";
             break;
@@ -179,14 +173,6 @@ void BytecodeReader::print(std::ostream& outStream) {
             break;
          }
 
-         case OP_POP_TO:
-         { // pop.to
-            location_t loc;
-            (*this) >> loc;
-            outStream << "pop.to " << (int) loc;
-            break;
-         }
-
             //         case OP_PUSH_I: // store.i  <integer>
             //         {
             //            int integer;
@@ -262,6 +248,54 @@ void BytecodeReader::print(std::ostream& outStream) {
             outStream << "div " << (int) loc1 << ", " << (int) loc2 << ", " << (int) loc3;
             break;
 
+         case OP_INC:
+         {
+            double decimal;
+            (*this) >> loc1 >> decimal;
+            outStream << "inc " << (int) loc1 << ", " << decimal;
+            break;
+         }
+
+         case OP_DEC:
+         {
+            double decimal;
+            (*this) >> loc1 >> decimal;
+            outStream << "dec " << (int) loc1 << ", " << decimal;
+            break;
+         }
+
+         case OP_ADDI:
+         {
+            double decimal;
+            (*this) >> loc1 >> loc2 >> decimal;
+            outStream << "addi " << (int) loc1 << ", " << (int) loc2 << ", " << decimal;
+            break;
+         }
+
+         case OP_SUBI:
+         {
+            double decimal;
+            (*this) >> loc1 >> loc2 >> decimal;
+            outStream << "subi " << (int) loc1 << ", " << (int) loc2 << ", " << decimal;
+            break;
+         }
+
+         case OP_MULI:
+         {
+            double decimal;
+            (*this) >> loc1 >> loc2 >> decimal;
+            outStream << "muli " << (int) loc1 << ", " << (int) loc2 << ", " << decimal;
+            break;
+         }
+
+         case OP_DIVI:
+         {
+            double decimal;
+            (*this) >> loc1 >> loc2 >> decimal;
+            outStream << "divi " << (int) loc1 << ", " << (int) loc2 << ", " << decimal;
+            break;
+         }
+
          case OP_JUMP:
          {
             index_t index;
@@ -277,6 +311,120 @@ void BytecodeReader::print(std::ostream& outStream) {
             outStream << "jump.cond " << (int) loc << ", " << index;
             break;
          }
+
+         case OP_JEQ:
+         {
+            location_t loc1, loc2;
+            index_t index;
+            (*this) >> loc1 >> loc2 >> index;
+            outStream << "jeq " << (int) loc1 << ", " << (int) loc2 << ", " << index;
+            break;
+         }
+
+         case OP_JNEQ:
+         {
+            location_t loc1, loc2;
+            index_t index;
+            (*this) >> loc1 >> loc2 >> index;
+            outStream << "jneq " << (int) loc1 << ", " << (int) loc2 << ", " << index;
+            break;
+         }
+
+         case OP_JGR:
+         {
+            location_t loc1, loc2;
+            index_t index;
+            (*this) >> loc1 >> loc2 >> index;
+            outStream << "jgr " << (int) loc1 << ", " << (int) loc2 << ", " << index;
+            break;
+         }
+
+         case OP_JGRE:
+         {
+            location_t loc1, loc2;
+            index_t index;
+            (*this) >> loc1 >> loc2 >> index;
+            outStream << "jgre " << (int) loc1 << ", " << (int) loc2 << ", " << index;
+            break;
+         }
+
+         case OP_JLS:
+         {
+            location_t loc1, loc2;
+            index_t index;
+            (*this) >> loc1 >> loc2 >> index;
+            outStream << "jls " << (int) loc1 << ", " << (int) loc2 << ", " << index;
+            break;
+         }
+
+         case OP_JLSE:
+         {
+            location_t loc1, loc2;
+            index_t index;
+            (*this) >> loc1 >> loc2 >> index;
+            outStream << "jlse " << (int) loc1 << ", " << (int) loc2 << ", " << index;
+            break;
+         }
+
+         case OP_JEQI:
+         {
+            location_t loc;
+            double decimal;
+            index_t index;
+            (*this) >> loc >> decimal >> index;
+            outStream << "jeqi " << (int) loc << ", " << decimal << ", " << index;
+            break;
+         }
+
+         case OP_JNEQI:
+         {
+            location_t loc;
+            double decimal;
+            index_t index;
+            (*this) >> loc >> decimal >> index;
+            outStream << "jneqi " << (int) loc << ", " << decimal << ", " << index;
+            break;
+         }
+
+         case OP_JGRI:
+         {
+            location_t loc;
+            double decimal;
+            index_t index;
+            (*this) >> loc >> decimal >> index;
+            outStream << "jgri " << (int) loc << ", " << decimal << ", " << index;
+            break;
+         }
+
+         case OP_JGREI:
+         {
+            location_t loc;
+            double decimal;
+            index_t index;
+            (*this) >> loc >> decimal >> index;
+            outStream << "jgrei " << (int) loc << ", " << decimal << ", " << index;
+            break;
+         }
+
+         case OP_JLSI:
+         {
+            location_t loc;
+            double decimal;
+            index_t index;
+            (*this) >> loc >> decimal >> index;
+            outStream << "jlsi " << (int) loc << ", " << decimal << ", " << index;
+            break;
+         }
+
+         case OP_JLSEI:
+         {
+            location_t loc;
+            double decimal;
+            index_t index;
+            (*this) >> loc >> decimal >> index;
+            outStream << "jlsei " << (int) loc << ", " << decimal << ", " << index;
+            break;
+         }
          case OP_RETURN_NIL:
             outStream << "ret.nil";
             break;
@@ -289,43 +437,56 @@ void BytecodeReader::print(std::ostream& outStream) {
 
             break;
          }
-         case OP_PCALL_SF_G:
+         case OP_CALL_SF_G:
          {
-            location_t function;
-            (*this) >> function;
-            outStream << "pcall_sf.g " << (int) function;
+            location_t function, window, target;
+            small_size_t nArguments;
+            (*this) >> function >> window >> nArguments >> target;
+            outStream << "call_sf.g " << (int) function << ", " << (int) window << ", " << (int) nArguments << ", " << (int) target;
             break;
          }
-         case OP_PCALL_SF_L:
+         case OP_CALL_SF_L:
          {
-            location_t function;
-            (*this) >> function;
-            outStream << "pcall_sf.l " << (int) function;
+            location_t function, window, target;
+            small_size_t nArguments;
+            (*this) >> function >> window >> nArguments >> target;
+            outStream << "call_sf.l " << (int) function << ", " << (int) window << ", " << (int) nArguments << ", " << (int) target;
             break;
          }
-         case OP_CALL_SF_G:
+         case OP_CALL_BF:
          {
-            location_t function;
+            index_t binding;
+            location_t window, target;
             small_size_t nArguments;
-            (*this) >> function >> nArguments;
-            outStream << "call_sf.g " << (int) function << ", " << (int) nArguments;
+            (*this) >> binding >> window >> nArguments >> target;
+            outStream << "call_bf " << binding << ", " << (int) window << ", " << (int) nArguments << ", " << (int) target;
             break;
          }
-         case OP_CALL_SF_L:
+         case OP_TAIL_CALL_SF_G:
          {
-            location_t function;
+            location_t function, window;
             small_size_t nArguments;
-            (*this) >> function >> nArguments;
-            outStream << "call_sf.l " << (int) function << ", " << (int) nArguments;
+            (*this) >> function >> window >> nArguments;
+            outStream << "tcall_sf.g " << (int) function << ", " << (int) window << ", " << (int) nArguments;
+            break;
+         }
+         case OP_TAIL_CALL_SF_L:
+         {
+            location_t function, window;
+            small_size_t nArguments;
+            (*this) >> function >> window >> nArguments;
+            outStream << "tcall_sf.l " << (int) function << ", " << (int) window << ", " << (int) nArguments;
             break;
          }
          case OP_CALL_HF:
+         case OP_CALL_HF_S:
          {
-            HostFunctionGroupID hfID;
+            index_t hfID;
             FunctionID cID;
+            location_t window, target;
             small_size_t nArguments;
-            (*this) >> hfID >> cID >> nArguments;
-            outStream << "call_hf " << hfID << ", " << (int) cID << ", " << (int) nArguments;
+            (*this) >> hfID >> cID >> window >> nArguments >> target;
+            outStream << ((op == OP_CALL_HF) ? "call_hf " : "call_hf.s ") << hfID << ", " << (int) cID << ", " << (int) window << ", " << (int) nArguments << ", " << (int) target;
             break;
          }
 
@@ -402,6 +563,60 @@ void BytecodeReader::print(std::ostream& outStream) {
             break;
          }
 
+         case OP_EQI:
+         {
+            location_t loc1, loc2;
+            double decimal;
+            (*this) >> loc1 >> loc2 >> decimal;
+            outStream << "eqi " << (int) loc1 << ", " << (int) loc2 << ", " << decimal;
+            break;
+         }
+
+         case OP_NEQI:
+         {
+            location_t loc1, loc2;
+            double decimal;
+            (*this) >> loc1 >> loc2 >> decimal;
+            outStream << "neqi " << (int) loc1 << ", " << (int) loc2 << ", " << decimal;
+            break;
+         }
+
+         case OP_GRI:
+         {
+            location_t loc1, loc2;
+            double decimal;
+            (*this) >> loc1 >> loc2 >> decimal;
+            outStream << "gri " << (int) loc1 << ", " << (int) loc2 << ", " << decimal;
+            break;
+         }
+
+         case OP_GREI:
+         {
+            location_t loc1, loc2;
+            double decimal;
+            (*this) >> loc1 >> loc2 >> decimal;
+            outStream << "grei " << (int) loc1 << ", " << (int) loc2 << ", " << decimal;
+            break;
+         }
+
+         case OP_LSI:
+         {
+            location_t loc1, loc2;
+            double decimal;
+            (*this) >> loc1 >> loc2 >> decimal;
+            outStream << "lsi " << (int) loc1 << ", " << (int) loc2 << ", " << decimal;
+            break;
+         }
+
+         case OP_LSEI:
+         {
+            location_t loc1, loc2;
+            double decimal;
+            (*this) >> loc1 >> loc2 >> decimal;
+            outStream << "lsei " << (int) loc1 << ", " << (int) loc2 << ", " << decimal;
+            break;
+         }
+
          case OP_LIST_NEW:
          {
             location_t loc;
@@ -447,6 +662,65 @@ void BytecodeReader::print(std::ostream& outStream) {
             outStream << "set " << (int) loc1 << ", " << (int) loc2 << ", " << (int) loc3;
             break;
          }
+         case OP_SLICE:
+         {
+            location_t loc1, loc2, loc3, loc4;
+            (*this) >> loc1 >> loc2 >> loc3 >> loc4;
+            outStream << "slice " << (int) loc1 << ", " << (int) loc2 << ", " << (int) loc3 << ", " << (int) loc4;
+            break;
+         }
+         case OP_LEN:
+         {
+            location_t loc1, loc2;
+            (*this) >> loc1 >> loc2;
+            outStream << "len " << (int) loc1 << ", " << (int) loc2;
+            break;
+         }
+         case OP_FLOOR:
+         {
+            location_t loc1, loc2;
+            (*this) >> loc1 >> loc2;
+            outStream << "floor " << (int) loc1 << ", " << (int) loc2;
+            break;
+         }
+         case OP_SQRT:
+         {
+            location_t loc1, loc2;
+            (*this) >> loc1 >> loc2;
+            outStream << "sqrt " << (int) loc1 << ", " << (int) loc2;
+            break;
+         }
+         case OP_ABS:
+         {
+            location_t loc1, loc2;
+            (*this) >> loc1 >> loc2;
+            outStream << "abs " << (int) loc1 << ", " << (int) loc2;
+            break;
+         }
+         case OP_APPEND:
+         {
+            location_t loc1, loc2, loc3;
+            (*this) >> loc1 >> loc2 >> loc3;
+            outStream << "append " << (int) loc1 << ", " << (int) loc2 << ", " << (int) loc3;
+            break;
+         }
+         case OP_MIN:
+         {
+            location_t loc1, loc2, loc3;
+            (*this) >> loc1 >> loc2 >> loc3;
+            outStream << "min " << (int) loc1 << ", " << (int) loc2 << ", " << (int) loc3;
+            break;
+         }
+         case OP_MAX:
+         {
+            location_t loc1, loc2, loc3;
+            (*this) >> loc1 >> loc2 >> loc3;
+            outStream << "max " << (int) loc1 << ", " << (int) loc2 << ", " << (int) loc3;
+            break;
+         }
+         case OP_HALT:
+            outStream << "halt";
+            break;
          default:
             break;
       }
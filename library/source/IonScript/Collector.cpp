@@ -0,0 +1,204 @@
+/*******************************************************************************
+ * IonScript                                                                   *
+ * (c) 2010-2011 Canio Massimo Tristano <massimo.tristano@gmail.com>           *
+ *                                                                             *
+ * This software is provided 'as-is', without any express or implied           *
+ * warranty. In no event will the authors be held liable for any damages       *
+ * arising from the use of this software.                                      *
+ *                                                                             *
+ * Permission is granted to anyone to use this software for any purpose,       *
+ * including commercial applications, and to alter it and redistribute it      *
+ * freely, subject to the following restrictions:                              *
+ *                                                                             *
+ * 1. The origin of this software must not be misrepresented; you must not     *
+ * claim that you wrote the original software. If you use this software        *
+ * in a product, an acknowledgment in the product documentation would be       *
+ * appreciated but is not required.                                            *
+ *                                                                             *
+ * 2. Altered source versions must be plainly marked as such, and must not be  *
+ * misrepresented as being the original software.                              *
+ *                                                                             *
+ * 3. This notice may not be removed or altered from any source                *
+ * distribution.                                                               *
+ ******************************************************************************/
+
+#include "Collector.h"
+
+#include <vector>
+
+using namespace std;
+using namespace ionscript;
+
+const size_t Collector::kDefaultThreshold;
+const double Collector::kDefaultGrowth = 0.25;
+const int Collector::kReachable;
+
+// the growth is spelled out as kDefaultGrowth is not a constant expression, it may not be initialized yet for allocators with
+// static storage duration
+ContainerHeap::ContainerHeap() : pFirst(0), containersCount(0), allocationsCount(0), nextCollection(Collector::kDefaultThreshold),
+threshold(Collector::kDefaultThreshold), growth(0.25), collectionsCount(0), collectedCount(0), collecting(false) { }
+
+ContainerHeader::ContainerHeader(void* pObject, const char* typeName, bool dictionary)
+: ValueHeader(pObject, typeName, true), mpHeap(0), mpPrevious(0), mpNext(0), mExternalReferences(0), mDictionary(dictionary) {
+   Collector::track(this);
+}
+
+ContainerHeader::~ContainerHeader() {
+   Collector::untrack(this);
+}
+
+void Collector::track(ContainerHeader* pHeader) {
+   ContainerHeap* pHeap = Allocator::getCurrent().getContainers();
+   if (!pHeap)
+      return;
+   if (++pHeap->allocationsCount >= pHeap->nextCollection && pHeap->nextCollection && !pHeap->collecting)
+      collect(*pHeap);
+
+   pHeader->mpHeap = pHeap;
+   pHeader->mpNext = pHeap->pFirst;
+   if (pHeap->pFirst)
+      pHeap->pFirst->mpPrevious = pHeader;
+   pHeap->pFirst = pHeader;
+   pHeap->containersCount++;
+}
+
+void Collector::untrack(ContainerHeader* pHeader) {
+   ContainerHeap* pHeap = pHeader->mpHeap;
+   if (!pHeap)
+      return;
+   if (pHeader->mpPrevious)
+      pHeader->mpPrevious->mpNext = pHeader->mpNext;
+   else
+      pHeap->pFirst = pHeader->mpNext;
+   if (pHeader->mpNext)
+      pHeader->mpNext->mpPrevious = pHeader->mpPrevious;
+   pHeap->containersCount--;
+}
+
+template <typename Function>
+void Collector::forEachElement(ContainerHeader* pHeader, Function function) {
+   if (pHeader->mDictionary) {
+      Dictionary& dictionary = static_cast<ValueCell<Dictionary>*> (pHeader)->payload;
+      for (Dictionary::iterator it = dictionary.begin(); it != dictionary.end(); ++it) {
+         function(it->first);
+         function(it->second);
+      }
+   } else {
+      ValueCell<List>* pList = static_cast<ValueCell<List>*> (pHeader);
+      for (size_t i = 0; i < pList->payload.size(); i++)
+         function(pList->payload[i]);
+      function(pList->backing);
+   }
+}
+
+ContainerHeader* Collector::getContainer(const Value& value, const ContainerHeap& heap) {
+   if (!value.isList() && !value.isDictonary())
+      return 0;
+   ContainerHeader* pHeader = static_cast<ContainerHeader*> (value.getHeader());
+   return (pHeader->mpHeap == &heap) ? pHeader : 0;
+}
+
+void Collector::subtractReference(const Value& value, const ContainerHeap& heap) {
+   if (ContainerHeader* pHeader = getContainer(value, heap))
+      pHeader->mExternalReferences--;
+}
+
+void Collector::markReachable(const Value& value, const ContainerHeap& heap, vector<ContainerHeader*>& stack) {
+   ContainerHeader* pHeader = getContainer(value, heap);
+   if (pHeader && pHeader->mExternalReferences != kReachable) {
+      pHeader->mExternalReferences = kReachable;
+      stack.push_back(pHeader);
+   }
+}
+
+size_t Collector::collect() {
+   ContainerHeap* pHeap = Allocator::getCurrent().getContainers();
+   return pHeap ? collect(*pHeap) : 0;
+}
+
+size_t Collector::collect(ContainerHeap& heap) {
+   if (heap.collecting)
+      return 0;
+   heap.collecting = true;
+
+   // subtract the references between containers, what is left comes from outside
+   for (ContainerHeader* p = heap.pFirst; p; p = p->mpNext)
+      p->mExternalReferences = p->mReferenceCount;
+   for (ContainerHeader* p = heap.pFirst; p; p = p->mpNext)
+      forEachElement(p, [&heap](const Value & value) {
+         subtractReference(value, heap);
+      });
+
+   // containers referenced from outside are reachable and so is their content
+   vector<ContainerHeader*> stack;
+   for (ContainerHeader* p = heap.pFirst; p; p = p->mpNext) {
+      if (p->mExternalReferences <= 0)
+         continue;
+      p->mExternalReferences = kReachable;
+      stack.push_back(p);
+      while (!stack.empty()) {
+         ContainerHeader* pReachable = stack.back();
+         stack.pop_back();
+         forEachElement(pReachable, [&heap, &stack](const Value & value) {
+            markReachable(value, heap, stack);
+         });
+      }
+   }
+
+   // the others are only referenced by each other: holding them while their content is released breaks their cycles without
+   // deleting any of them before it is cleared
+   vector<ContainerHeader*> garbage;
+   for (ContainerHeader* p = heap.pFirst; p; p = p->mpNext) {
+      if (p->mExternalReferences != kReachable) {
+         p->mReferenceCount++;
+         garbage.push_back(p);
+      }
+   }
+   for (size_t i = 0; i < garbage.size(); i++) {
+      if (garbage[i]->mDictionary)
+         static_cast<ValueCell<Dictionary>*> (garbage[i])->payload.clear();
+      else {
+         ValueCell<List>* pList = static_cast<ValueCell<List>*> (garbage[i]);
+         pList->mpObject = &pList->payload;
+         pList->mShared = false;
+         pList->payload.clear();
+         pList->backing.setNil();
+      }
+   }
+   for (size_t i = 0; i < garbage.size(); i++) {
+      if (--garbage[i]->mReferenceCount <= 0)
+         delete garbage[i];
+   }
+
+   heap.allocationsCount = 0;
+   if (heap.threshold)
+      heap.nextCollection = max(heap.threshold, (size_t) (heap.containersCount * heap.growth));
+   heap.collectionsCount++;
+   heap.collectedCount += garbage.size();
+   heap.collecting = false;
+   return garbage.size();
+}
+
+void Collector::setThresholds(size_t threshold, double growth) {
+   ContainerHeap* pHeap = Allocator::getCurrent().getContainers();
+   if (!pHeap)
+      return;
+   pHeap->threshold = threshold;
+   pHeap->growth = growth;
+   pHeap->nextCollection = threshold ? max(threshold, (size_t) (pHeap->containersCount * growth)) : 0;
+}
+
+size_t Collector::getContainersCount() {
+   ContainerHeap* pHeap = Allocator::getCurrent().getContainers();
+   return pHeap ? pHeap->containersCount : 0;
+}
+
+size_t Collector::getCollectionsCount() {
+   ContainerHeap* pHeap = Allocator::getCurrent().getContainers();
+   return pHeap ? pHeap->collectionsCount : 0;
+}
+
+size_t Collector::getCollectedCount() {
+   ContainerHeap* pHeap = Allocator::getCurrent().getContainers();
+   return pHeap ? pHeap->collectedCount : 0;
+}
@@ -0,0 +1,160 @@
+/*******************************************************************************
+ * IonScript                                                                   *
+ * (c) 2010-2011 Canio Massimo Tristano <massimo.tristano@gmail.com>           *
+ *                                                                             *
+ * This software is provided 'as-is', without any express or implied           *
+ * warranty. In no event will the authors be held liable for any damages       *
+ * arising from the use of this software.                                      *
+ *                                                                             *
+ * Permission is granted to anyone to use this software for any purpose,       *
+ * including commercial applications, and to alter it and redistribute it      *
+ * freely, subject to the following restrictions:                              *
+ *                                                                             *
+ * 1. The origin of this software must not be misrepresented; you must not     *
+ * claim that you wrote the original software. If you use this software        *
+ * in a product, an acknowledgment in the product documentation would be       *
+ * appreciated but is not required.                                            *
+ *                                                                             *
+ * 2. Altered source versions must be plainly marked as such, and must not be  *
+ * misrepresented as being the original software.                              *
+ *                                                                             *
+ * 3. This notice may not be removed or altered from any source                *
+ * distribution.                                                               *
+ ******************************************************************************/
+
+#ifndef ION_SCRIPT_COLLECTOR_H
+#define	ION_SCRIPT_COLLECTOR_H
+
+#include "Typedefs.h"
+#include "Value.h"
+#include "Dictionary.h"
+
+#include <typeinfo>
+#include <stddef.h>
+
+namespace ionscript {
+
+   /**
+    * Header of the heap values that can contain other values, lists and dictionaries, and therefore take part in reference cycles.
+    * Every such header is linked into the ContainerHeap of the Allocator that allocated it, which the Collector scans, and
+    * remembers it: the container is unlinked from that heap whatever thread or allocator is current when it is destroyed.
+    */
+   class ContainerHeader : public ValueHeader {
+      friend class Collector;
+
+   public:
+      virtual ~ContainerHeader();
+
+   protected:
+      ContainerHeader(void* pObject, const char* typeName, bool dictionary);
+
+   private:
+      /** The heap the container is linked into, 0 if it is not tracked. */
+      ContainerHeap* mpHeap;
+      /** Neighbours in the list of containers of the heap. */
+      ContainerHeader* mpPrevious;
+      ContainerHeader* mpNext;
+      /** Reference count minus the references from other containers while collecting, kReachable once proven reachable. */
+      int mExternalReferences;
+      /** Whether the payload is a Dictionary rather than a List. */
+      bool mDictionary;
+   };
+
+   /**
+    * A list sharing its elements with its slices (see Value::slice()) keeps its payload empty: its header points to the payload of
+    * the backing list that holds them, and it only sees a range of it.
+    */
+   template <>
+   class ValueCell<List> : public ContainerHeader, public Allocated {
+   public:
+      ValueCell() : ContainerHeader(&payload, typeid (List).name(), false), offset(0), length(0) { }
+
+      List payload;
+      /** The backing list holding the elements of a shared list, nil otherwise. */
+      Value backing;
+      /** Index of the first element of a shared list in its backing list and number of its elements. */
+      size_t offset;
+      size_t length;
+   };
+
+   template <>
+   class ValueCell<Dictionary> : public ContainerHeader, public Allocated {
+   public:
+      ValueCell() : ContainerHeader(&payload, typeid (Dictionary).name(), true) { }
+
+      Dictionary payload;
+   };
+
+   /**
+    * Frees lists and dictionaries that are only referenced by each other, which reference counting alone never deletes. It performs
+    * trial deletion over the containers of the current Allocator, those of the VirtualMachine running scripts: the references
+    * coming from other containers of the same allocator are subtracted from every reference count, the containers left with
+    * references (held by the value stacks, by the host, by managed objects or by containers of other allocators) are reachable
+    * and so is everything they contain, the rest is garbage and is cleared to break its cycles.
+    * Each allocator has its own containers, thresholds and statistics (see ContainerHeap). The containers of the process-wide
+    * allocator, made by the host outside of the runs, are not tracked.
+    */
+   class Collector {
+   public:
+      /** Default number of containers allocated between two automatic collections. */
+      static const size_t kDefaultThreshold = 10000;
+      /** Default growth, relative to the containers surviving the last collection, also required before collecting again. */
+      static const double kDefaultGrowth;
+
+      /**
+       * Collects the unreachable containers of the current allocator.
+       * @return the number of freed containers.
+       */
+      static size_t collect();
+      /**
+       * Sets when containers allocations of the current allocator trigger a collection. A collection runs once both given number of containers have been
+       * allocated since the last one, and the allocated containers exceed given fraction of those that survived it: the second
+       * condition keeps collections of large heaps infrequent enough for their cost to be linear in the allocations.
+       * @param threshold minimum number of containers allocations between two collections, 0 to only collect on collect().
+       * @param growth fraction of the surviving containers to be allocated before collecting again.
+       */
+      static void setThresholds(size_t threshold, double growth);
+      /**
+       * @return the number of lists and dictionaries currently allocated by the current allocator.
+       */
+      static size_t getContainersCount();
+      /**
+       * @return the number of collections of the containers of the current allocator.
+       */
+      static size_t getCollectionsCount();
+      /**
+       * @return the number of containers freed by the collections of the current allocator.
+       */
+      static size_t getCollectedCount();
+
+   private:
+      static const int kReachable = -1;
+
+      /**
+       * Links a new container, running a collection first if the thresholds are met.
+       */
+      static void track(ContainerHeader* pHeader);
+      static void untrack(ContainerHeader* pHeader);
+      static size_t collect(ContainerHeap& heap);
+      /**
+       * @return the container held by given value if it belongs to given heap, 0 otherwise.
+       */
+      static ContainerHeader* getContainer(const Value& value, const ContainerHeap& heap);
+      /**
+       * Subtracts a reference from the given contained value if it is a container of given heap.
+       */
+      static void subtractReference(const Value& value, const ContainerHeap& heap);
+      /**
+       * Marks the given contained value as reachable if it is a container of given heap that was not, appending it to the given
+       * stack.
+       */
+      static void markReachable(const Value& value, const ContainerHeap& heap, std::vector<ContainerHeader*>& stack);
+
+      template <typename Function>
+      static void forEachElement(ContainerHeader* pHeader, Function function);
+
+      friend class ContainerHeader;
+   };
+}
+
+#endif	/* ION_SCRIPT_COLLECTOR_H */
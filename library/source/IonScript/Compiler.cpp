@@ -28,6 +28,8 @@
 #include "Bytecode.h"
 #include "Parser.h"
 
+#include <iomanip>
+#include <limits>
 #include <map>
 
 using namespace std;
@@ -38,6 +40,8 @@ Compiler::Compiler(const HostFunctionsMap& hostFunctionsMap) : mHostFunctionsMap
 void Compiler::compile(const SyntaxTree& tree, BytecodeWriter& output) {
    mNamesStack.clear();
    mScriptFunctionsLocations.clear();
+   mCallWindowEnd = 0;
+   mFirstFreeRegister = -1;
 
    mActivationFramePointer.push(0);
    mnRequiredRegisters.push(0);
@@ -46,7 +50,7 @@ void Compiler::compile(const SyntaxTree& tree, BytecodeWriter& output) {
 
    output << kMagicNumber << kVersion;
    size_t sizeIndex = output.getSize();
-   output << (size_t) 0;
+   output << (index_t) 0;
 
    // Set a temporary op for registers preallocaiton
    output << OP_REG;
@@ -55,9 +59,10 @@ void Compiler::compile(const SyntaxTree& tree, BytecodeWriter& output) {
 
    // We're ready to go!
    compile(tree, output, -1);
+   output << OP_HALT;
 
    output.set(registerCountIndex, mnRequiredRegisters.top());
-   output.set(sizeIndex, output.getSize());
+   output.set(sizeIndex, (index_t) output.getSize());
 }
 
 //
@@ -91,10 +96,7 @@ int Compiler::compile(const SyntaxTree& tree, BytecodeWriter& output, location_t
          list<SyntaxTree*>::const_iterator it = tree.getChildren().begin();
          const SyntaxTree* pConditionTree = *it;
 
-         target = compile(*pConditionTree, output, target);
-         output << OP_JUMP_COND << target;
-         size_t jumpIndex = output.getSize();
-         output << (index_t) 0;
+         size_t jumpIndex = compileConditionalJump(*pConditionTree, output, target);
 
          ++it;
          const SyntaxTree* pIfBlock = *it;
@@ -136,11 +138,8 @@ int Compiler::compile(const SyntaxTree& tree, BytecodeWriter& output, location_t
 
          index_t beginning = output.getSize();
 
-         location_t result = compile(**it, output, target);
-
-         output << OP_JUMP_COND << result;
-         index_t jumpIndex = output.getSize();
-         output << (index_t) 0;
+         location_t result = target;
+         index_t jumpIndex = compileConditionalJump(**it, output, result);
 
          ++it; //block
          vector<index_t> continues;
@@ -161,7 +160,7 @@ int Compiler::compile(const SyntaxTree& tree, BytecodeWriter& output, location_t
             output.set(continues[i], beginning);
 
          for (size_t i = 0; i < breaks.size(); i++)
-            output.set(breaks[i], output.getSize());
+            output.set(breaks[i], (index_t) output.getSize());
 
          mContinues.pop();
          mBreaks.pop();
@@ -200,11 +199,8 @@ int Compiler::compile(const SyntaxTree& tree, BytecodeWriter& output, location_t
 
          index_t beginning = output.getSize();
 
-         location_t result = compile(conditionTree, output, target);
-
-         output << OP_JUMP_COND << result;
-         index_t jumpIndex = output.getSize();
-         output << (index_t) 0;
+         location_t result = target;
+         index_t jumpIndex = compileConditionalJump(conditionTree, output, result);
 
          vector<index_t> continues;
          vector<index_t> breaks;
@@ -227,7 +223,7 @@ int Compiler::compile(const SyntaxTree& tree, BytecodeWriter& output, location_t
             output.set(continues[i], incrementIndex);
 
          for (size_t i = 0; i < breaks.size(); i++)
-            output.set(breaks[i], output.getSize());
+            output.set(breaks[i], (index_t) output.getSize());
 
          mContinues.pop();
          mBreaks.pop();
@@ -316,6 +312,13 @@ int Compiler::compile(const SyntaxTree& tree, BytecodeWriter& output, location_t
          }
 
          if (tree.hasChildren()) {
+            // "return f(...)" within a script function reuses the current frame for the call to f
+            if (tree.left()->type == SyntaxTree::TYPE_FUNCTION_CALL && mActivationFramePointer.size() > 1 &&
+                    isScriptFunction(tree.left()->str)) {
+               compileFunctionCall(*tree.left(), output, target, true);
+               return target;
+            }
+
             location_t result = compile(*tree.left(), output, target);
             output << OP_RETURN << result;
             return result;
@@ -326,99 +329,8 @@ int Compiler::compile(const SyntaxTree& tree, BytecodeWriter& output, location_t
       }
 
       case SyntaxTree::TYPE_FUNCTION_CALL:
-      {
-         if (mDeclareOnly.top()) {
-            std::list<SyntaxTree*>::const_iterator it;
-            for (it = tree.getChildren().begin(); it != tree.getChildren().end(); it++)
-               compile(**it, output, -1);
-            return target;
-         }
-
-         // Lookup for the callable in the names stack
-         OpCode callOp = OP_CALL_SF_G;
-         location_t loc = 0; // useless initialization
-         HostFunctionGroupID hfgID = 0;
-         FunctionID fID = 0;
-
-         if (findLocalName(tree.str, loc))
-            callOp = OP_CALL_SF_L;
-         else {
-            map<string, location_t>::const_iterator sfit = mScriptFunctionsLocations.find(tree.str);
-            if (sfit == mScriptFunctionsLocations.end()) {
-               HostFunctionsMap::const_iterator hfit = mHostFunctionsMap.find(tree.str);
-               if (hfit != mHostFunctionsMap.end()) {
-                  callOp = OP_CALL_HF;
-
-                  const FunctionInfo& info = hfit->second;
-
-                  hfgID = info.hfgID;
-                  fID = info.fID;
-
-                  // Make sure that the number of arguments falls within the range between minArgumentsCount and maxArgumentsCount.
-                  if ((int) tree.getChildren().size() < info.minArgumentsCount ||
-                          (info.maxArgumentsCount != -1 && (int) tree.getChildren().size() > info.maxArgumentsCount)) {
-                     stringstream ss;
-                     ss << "wrong number of arguments given. ";
-                     if (info.maxArgumentsCount == -1)
-                        ss << "It must be at least " << info.minArgumentsCount;
-                     else if (info.maxArgumentsCount == info.minArgumentsCount)
-                        ss << "It must be exactly " << info.minArgumentsCount;
-                     else
-                        ss << "It must be between " << info.minArgumentsCount << " and " << info.maxArgumentsCount;
-                     ss << " while it is " << tree.getChildren().size() << ".";
-                     error(tree.sourceLineNumber, ss.str());
-                  }
-
-               } else
-                  error(tree.sourceLineNumber, "Could not find function \"" + tree.str + "\"");
-            } else
-               loc = sfit->second;
-         }
-
-         std::list<SyntaxTree*>::const_iterator it;
-
-         mDeclareOnly.push(true);
-         for (it = tree.getChildren().begin(); it != tree.getChildren().end(); it++) {
-            location_t regLoc = target;
-            if (regLoc >= 0)
-               regLoc = -1;
-
-            location_t result = compile(**it, output, regLoc);
-
-            mnRequiredRegisters.top() = max((int) mnRequiredRegisters.top(), (int) -result);
-         }
-         mDeclareOnly.pop();
-
-         if (callOp != OP_CALL_HF) {
-            if (callOp == OP_CALL_SF_G)
-               output << OP_PCALL_SF_G << loc;
-            else
-               output << OP_PCALL_SF_L << loc;
-         }
-
-         for (it = tree.getChildren().begin(); it != tree.getChildren().end(); it++) {
-            location_t regLoc = target;
-            if (regLoc >= 0)
-               regLoc = -1;
-
-            location_t result = compile(**it, output, regLoc);
-
-            mnRequiredRegisters.top() = max((int) mnRequiredRegisters.top(), (int) -result);
-
-            output << OP_PUSH_VAL << result;
-         }
-
-         if (callOp == OP_CALL_HF)
-            output << callOp << hfgID << fID << (small_size_t) tree.getChildren().size();
-         else
-            output << callOp << loc << (small_size_t) tree.getChildren().size();
-
-         mnRequiredRegisters.top() = max((int) -target, (int) mnRequiredRegisters.top());
-
-         output << OP_POP_TO << target;
-
+         compileFunctionCall(tree, output, target, false);
          return target;
-      }
 
       case SyntaxTree::TYPE_NIL:
          output << OP_STORE_AT_NIL << target;
@@ -441,9 +353,10 @@ int Compiler::compile(const SyntaxTree& tree, BytecodeWriter& output, location_t
 
       case SyntaxTree::TYPE_NUMBER:
       {
+         // the constant is named after its exact value, numbers differing past the default precision must not share it
          location_t loc = 0;
          stringstream s;
-         s << tree.number;
+         s << setprecision(numeric_limits<double>::max_digits10) << tree.number;
          if (findLocalName(s.str(), loc))
             return loc;
          else {
@@ -484,13 +397,13 @@ int Compiler::compile(const SyntaxTree& tree, BytecodeWriter& output, location_t
       {
          output << OP_LIST_NEW << target;
          std::list<SyntaxTree*>::const_iterator it;
-         location_t reg = (target < 0) ? target - 1 : -1;
+         location_t reg = (target < 0) ? target - 1 : mFirstFreeRegister;
          for (it = tree.getChildren().begin(); it != tree.getChildren().end(); it++) {
             location_t result = compile(**it, output, reg);
             output << OP_LIST_ADD << target << result;
 
             if (result < 0)
-               max((int) -result, (int) mnRequiredRegisters.top());
+               mnRequiredRegisters.top() = max((int) -result, (int) mnRequiredRegisters.top());
          }
 
          return target;
@@ -503,7 +416,7 @@ int Compiler::compile(const SyntaxTree& tree, BytecodeWriter& output, location_t
 
          for (it = tree.getChildren().begin(); it != tree.getChildren().end(); it++) {
 
-            location_t reg = (target < 0) ? target - 1 : -1;
+            location_t reg = (target < 0) ? target - 1 : mFirstFreeRegister;
 
             location_t index = compile(*(*it)->left(), output, reg);
 
@@ -533,7 +446,7 @@ int Compiler::compile(const SyntaxTree& tree, BytecodeWriter& output, location_t
             return target;
          }
 
-         location_t reg = (target < 0) ? target : -1;
+         location_t reg = (target < 0) ? target : mFirstFreeRegister;
          location_t listLoc = compile(*tree.left(), output, reg);
          if (listLoc == reg)
             reg--;
@@ -543,26 +456,60 @@ int Compiler::compile(const SyntaxTree& tree, BytecodeWriter& output, location_t
          return target;
       }
 
+      case SyntaxTree::TYPE_SLICE:
+      {
+         std::list<SyntaxTree*>::const_iterator it = tree.getChildren().begin();
+         if (mDeclareOnly.top()) {
+            for (; it != tree.getChildren().end(); it++)
+               compile(**it, output, -1);
+            return target;
+         }
+
+         // the container and both bounds need a location each, nil bounds included
+         location_t locations[3];
+         location_t reg = (target < 0) ? target : mFirstFreeRegister;
+         for (int i = 0; i < 3; i++, it++) {
+            locations[i] = compile(**it, output, reg);
+            if (locations[i] == reg) {
+               mnRequiredRegisters.top() = max((int) -reg, (int) mnRequiredRegisters.top());
+               reg--;
+            }
+         }
+
+         output << OP_SLICE << target << locations[0] << locations[1] << locations[2];
+         return target;
+      }
+
       case SyntaxTree::TYPE_ASSIGNEMENT:
       {
          if (tree.left()->type != SyntaxTree::TYPE_VARIABLE && tree.left()->type != SyntaxTree::TYPE_CONTAINER_ELEMENT)
             error(tree.sourceLineNumber, "In an assignement, left value must be a varible or a container element.");
 
          location_t listLoc = 0, indexLoc = 0, result = 0;
+         location_t valueTarget = target;
 
          if (tree.left()->type == SyntaxTree::TYPE_CONTAINER_ELEMENT) {
-            location_t reg = (target < 0) ? target : -1;
+            location_t reg = (target < 0) ? target : mFirstFreeRegister;
             listLoc = compile(*tree.left()->left(), output, reg);
             if (listLoc == reg) reg--;
             indexLoc = compile(*tree.left()->right(), output, reg);
+            if (indexLoc == reg) reg--;
 
+            // the value must not overwrite the registers holding the container and the index
+            if (target < 0) {
+               valueTarget = reg;
+               mnRequiredRegisters.top() = max((int) -reg, (int) mnRequiredRegisters.top());
+            }
          } else {
             mVariableDeclarationAllowed.push(true);
-            target = compile(*tree.left(), output, target);
+            target = valueTarget = compile(*tree.left(), output, target);
             mVariableDeclarationAllowed.pop();
          }
 
-         result = compile(*tree.right(), output, target);
+         if (tree.left()->type == SyntaxTree::TYPE_VARIABLE && compileIncrement(tree, output, target))
+            return target;
+
+         result = compile(*tree.right(), output, valueTarget);
 
          if (!mDeclareOnly.top()) {
             if (tree.left()->type == SyntaxTree::TYPE_CONTAINER_ELEMENT)
@@ -590,23 +537,8 @@ int Compiler::compile(const SyntaxTree& tree, BytecodeWriter& output, location_t
          return target;
 
       case SyntaxTree::TYPE_NOT:
-      {
-         if (mDeclareOnly.top()) {
-            compile(*tree.left(), output, 0);
-            return target;
-         }
-
-         location_t reg, left;
-
-         reg = (target < 0) ? target : -1;
-         left = compile(*tree.left(), output, reg);
-
-         if (reg < 0 && left == reg)
-            mnRequiredRegisters.top() = max((int) -reg, (int) mnRequiredRegisters.top());
-
-         output << OP_NOT << target << left;
+         compileExpressionNodeChild(tree, output, target, OP_NOT);
          return target;
-      }
 
       case SyntaxTree::TYPE_AND:
          compileExpressionNodeChildren(tree, output, target, OP_AND);
@@ -657,10 +589,45 @@ void Compiler::error(size_t line, const std::string & error) const {
    throw SemanticError(line, 0, error);
 }
 
+void Compiler::compileExpressionNodeChild(const SyntaxTree& node, BytecodeWriter& output, location_t target, OpCode op) {
+   if (mDeclareOnly.top()) {
+      compile(*node.left(), output, 0);
+      return;
+   }
+
+   location_t reg, left;
+
+   reg = (target < 0) ? target : mFirstFreeRegister;
+   left = compile(*node.left(), output, reg);
+
+   if (reg < 0 && left == reg)
+      mnRequiredRegisters.top() = max((int) -reg, (int) mnRequiredRegisters.top());
+   if (target < 0)
+      mnRequiredRegisters.top() = max((int) -target, (int) mnRequiredRegisters.top());
+
+   output << op << target << left;
+}
+
 void Compiler::compileExpressionNodeChildren(const SyntaxTree& node, BytecodeWriter& output, location_t target, OpCode op) {
    location_t reg, left, right;
 
-   reg = (target < 0) ? target : -1;
+   reg = (target < 0) ? target : mFirstFreeRegister;
+
+   const SyntaxTree* pOperand = selectImmediateOpCode(node, op);
+   if (pOperand) {
+      // the constant is embedded into the instruction, only the other operand needs a location
+      left = compile(*pOperand, output, reg);
+
+      if (reg < 0 && left == reg)
+         mnRequiredRegisters.top() = max((int) -reg, (int) mnRequiredRegisters.top());
+      if (target < 0)
+         mnRequiredRegisters.top() = max((int) -target, (int) mnRequiredRegisters.top());
+
+      if (!mDeclareOnly.top())
+         output << op << target << left << ((pOperand == node.left()) ? node.right() : node.left())->number;
+      return;
+   }
+
    left = compile(*node.left(), output, reg);
 
    if (reg < 0 && left == reg) {
@@ -680,6 +647,312 @@ void Compiler::compileExpressionNodeChildren(const SyntaxTree& node, BytecodeWri
       output << op << target << left << right;
 }
 
+size_t Compiler::compileConditionalJump(const SyntaxTree& condition, BytecodeWriter& output, location_t& target) {
+   OpCode op;
+   switch (condition.type) {
+      case SyntaxTree::TYPE_EQUALS: op = OP_JEQ;
+         break;
+      case SyntaxTree::TYPE_NOT_EQUALS: op = OP_JNEQ;
+         break;
+      case SyntaxTree::TYPE_GREATER: op = OP_JGR;
+         break;
+      case SyntaxTree::TYPE_GREATER_EQUALS: op = OP_JGRE;
+         break;
+      case SyntaxTree::TYPE_LESSER: op = OP_JLS;
+         break;
+      case SyntaxTree::TYPE_LESSER_EQUALS: op = OP_JLSE;
+         break;
+
+      default:
+      {
+         // evaluate the condition and test it
+         target = compile(condition, output, target);
+         output << OP_JUMP_COND << target;
+         size_t jumpIndex = output.getSize();
+         output << (index_t) 0;
+         return jumpIndex;
+      }
+   }
+
+   // comparisons jump by themselves, without storing their result
+   checkComparisonConsistency(condition);
+
+   location_t reg, left, right;
+
+   reg = (target < 0) ? target : mFirstFreeRegister;
+
+   const SyntaxTree* pOperand = selectImmediateOpCode(condition, op);
+   if (pOperand) {
+      left = compile(*pOperand, output, reg);
+
+      if (reg < 0 && left == reg)
+         mnRequiredRegisters.top() = max((int) -reg, (int) mnRequiredRegisters.top());
+
+      output << op << left << ((pOperand == condition.left()) ? condition.right() : condition.left())->number;
+      size_t jumpIndex = output.getSize();
+      output << (index_t) 0;
+      return jumpIndex;
+   }
+
+   left = compile(*condition.left(), output, reg);
+
+   if (reg < 0 && left == reg) {
+      mnRequiredRegisters.top() = max((int) -reg, (int) mnRequiredRegisters.top());
+      --reg;
+   }
+
+   right = compile(*condition.right(), output, reg);
+
+   if (reg < 0 && right == reg)
+      mnRequiredRegisters.top() = max((int) -reg, (int) mnRequiredRegisters.top());
+
+   output << op << left << right;
+   size_t jumpIndex = output.getSize();
+   output << (index_t) 0;
+   return jumpIndex;
+}
+
+bool Compiler::compileIncrement(const SyntaxTree& assignement, BytecodeWriter& output, location_t target) {
+   // matches "a = a + n" and "a = a - n", hence "a += n" and "a -= n", with a constant n
+   const SyntaxTree& expression = *assignement.right();
+   if ((expression.type != SyntaxTree::TYPE_SUM && expression.type != SyntaxTree::TYPE_DIFFERENCE) ||
+           expression.left()->type != SyntaxTree::TYPE_VARIABLE ||
+           expression.left()->str != assignement.left()->str ||
+           expression.right()->type != SyntaxTree::TYPE_NUMBER)
+      return false;
+
+   // the variable must already exist, exactly as reading it in the sum does
+   location_t source = compile(*expression.left(), output, target);
+   if (source != target)
+      return false;
+
+   if (!mDeclareOnly.top())
+      output << ((expression.type == SyntaxTree::TYPE_SUM) ? OP_INC : OP_DEC) << target << expression.right()->number;
+   return true;
+}
+
+void Compiler::compileFunctionCall(const SyntaxTree& tree, BytecodeWriter& output, location_t target, bool tailCall) {
+   if (mDeclareOnly.top()) {
+      std::list<SyntaxTree*>::const_iterator it;
+      for (it = tree.getChildren().begin(); it != tree.getChildren().end(); it++)
+         compile(**it, output, -1);
+      return;
+   }
+
+   // Lookup for the callable in the names stack
+   OpCode callOp = OP_CALL_SF_G;
+   location_t loc = 0; // useless initialization
+   HostFunctionGroupID hfgID = 0;
+   FunctionID fID = 0;
+   int bindingID = -1;
+   bool maySuspend = false;
+   int intrinsic = -1;
+
+   if (findLocalName(tree.str, loc))
+      callOp = OP_CALL_SF_L;
+   else {
+      map<string, location_t>::const_iterator sfit = mScriptFunctionsLocations.find(tree.str);
+      if (sfit == mScriptFunctionsLocations.end()) {
+         HostFunctionsMap::const_iterator hfit = mHostFunctionsMap.find(tree.str);
+         if (hfit != mHostFunctionsMap.end()) {
+            callOp = OP_CALL_HF;
+
+            const FunctionInfo& info = hfit->second;
+
+            hfgID = info.hfgID;
+            fID = info.fID;
+            bindingID = info.bindingID;
+            maySuspend = info.maySuspend;
+            intrinsic = info.intrinsic;
+
+            // Make sure that the number of arguments falls within the range between minArgumentsCount and maxArgumentsCount.
+            if ((int) tree.getChildren().size() < info.minArgumentsCount ||
+                    (info.maxArgumentsCount != -1 && (int) tree.getChildren().size() > info.maxArgumentsCount)) {
+               stringstream ss;
+               ss << "wrong number of arguments given. ";
+               if (info.maxArgumentsCount == -1)
+                  ss << "It must be at least " << info.minArgumentsCount;
+               else if (info.maxArgumentsCount == info.minArgumentsCount)
+                  ss << "It must be exactly " << info.minArgumentsCount;
+               else
+                  ss << "It must be between " << info.minArgumentsCount << " and " << info.maxArgumentsCount;
+               ss << " while it is " << tree.getChildren().size() << ".";
+               error(tree.sourceLineNumber, ss.str());
+            }
+
+         } else
+            error(tree.sourceLineNumber, "Could not find function \"" + tree.str + "\"");
+      } else
+         loc = sfit->second;
+   }
+
+   if (intrinsic >= 0 && compileIntrinsic(tree, output, target, (OpCode) intrinsic))
+      return;
+
+   std::list<SyntaxTree*>::const_iterator it;
+
+   location_t regLoc = (target < 0) ? target : mFirstFreeRegister;
+
+   // Declare every name the arguments need first, no value can be pushed while the window is being filled.
+   mDeclareOnly.push(true);
+   for (it = tree.getChildren().begin(); it != tree.getChildren().end(); it++) {
+      location_t result = compile(**it, output, regLoc);
+
+      mnRequiredRegisters.top() = max((int) mnRequiredRegisters.top(), (int) -result);
+   }
+   mDeclareOnly.pop();
+
+   // Arguments are evaluated straight into the window of slots right above the values of the caller (and above the
+   // windows of the calls whose arguments are being evaluated), where the callee will find them.
+   location_t window = max((int) (mNamesStack.size() - mActivationFramePointer.top()), (int) mCallWindowEnd);
+   location_t outerCallWindowEnd = mCallWindowEnd;
+   location_t outerFirstFreeRegister = mFirstFreeRegister;
+   mCallWindowEnd = window + tree.getChildren().size();
+   mFirstFreeRegister = regLoc;
+
+   location_t argument = window;
+   for (it = tree.getChildren().begin(); it != tree.getChildren().end(); it++, argument++) {
+      location_t result = compile(**it, output, argument);
+
+      mnRequiredRegisters.top() = max((int) mnRequiredRegisters.top(), (int) -result);
+
+      if (result != argument)
+         output << OP_MOVE << argument << result;
+   }
+
+   mCallWindowEnd = outerCallWindowEnd;
+   mFirstFreeRegister = outerFirstFreeRegister;
+
+   if (callOp == OP_CALL_HF && bindingID >= 0)
+      output << OP_CALL_BF << (index_t) bindingID;
+   else if (callOp == OP_CALL_HF)
+      output << (maySuspend ? OP_CALL_HF_S : OP_CALL_HF) << (index_t) hfgID << fID;
+   else {
+      if (tailCall)
+         callOp = (callOp == OP_CALL_SF_G) ? OP_TAIL_CALL_SF_G : OP_TAIL_CALL_SF_L;
+      output << callOp << loc;
+   }
+   output << window << (small_size_t) tree.getChildren().size();
+   if (callOp != OP_TAIL_CALL_SF_G && callOp != OP_TAIL_CALL_SF_L)
+      output << target;
+
+   mnRequiredRegisters.top() = max((int) -target, (int) mnRequiredRegisters.top());
+}
+
+bool Compiler::compileIntrinsic(const SyntaxTree& call, BytecodeWriter& output, location_t target, OpCode op) {
+   // the arguments are the operands of the instruction, which only exists for a certain number of them
+   size_t nOperands;
+   switch (op) {
+      case OP_LEN:
+      case OP_FLOOR:
+      case OP_SQRT:
+      case OP_ABS:
+         nOperands = 1;
+         break;
+      default:
+         nOperands = 2;
+   }
+
+   if (call.getChildren().size() != nOperands)
+      return false;
+
+   if (nOperands == 1)
+      compileExpressionNodeChild(call, output, target, op);
+   else
+      compileExpressionNodeChildren(call, output, target, op);
+   return true;
+}
+
+bool Compiler::isScriptFunction(const std::string& name) const {
+   // local names shadow script functions, which shadow host functions, exactly as in compileFunctionCall()
+   location_t loc;
+   return findLocalName(name, loc) || mScriptFunctionsLocations.find(name) != mScriptFunctionsLocations.end();
+}
+
+const SyntaxTree* Compiler::selectImmediateOpCode(const SyntaxTree& node, OpCode& op) const {
+   // op-code taking the constant as its second operand, and the one to use when the constant is the first operand
+   OpCode immediateOp, swappedOp;
+   switch (op) {
+      case OP_ADD: immediateOp = OP_ADDI;
+         swappedOp = OP_ADDI;
+         break;
+      case OP_SUB: immediateOp = OP_SUBI;
+         swappedOp = OP_SUBI;
+         break;
+      case OP_MUL: immediateOp = OP_MULI;
+         swappedOp = OP_MULI;
+         break;
+      case OP_DIV: immediateOp = OP_DIVI;
+         swappedOp = OP_DIVI;
+         break;
+      case OP_EQ: immediateOp = OP_EQI;
+         swappedOp = OP_EQI;
+         break;
+      case OP_NEQ: immediateOp = OP_NEQI;
+         swappedOp = OP_NEQI;
+         break;
+      case OP_GR: immediateOp = OP_GRI;
+         swappedOp = OP_LSI;
+         break;
+      case OP_GRE: immediateOp = OP_GREI;
+         swappedOp = OP_LSEI;
+         break;
+      case OP_LS: immediateOp = OP_LSI;
+         swappedOp = OP_GRI;
+         break;
+      case OP_LSE: immediateOp = OP_LSEI;
+         swappedOp = OP_GREI;
+         break;
+      case OP_JEQ: immediateOp = OP_JEQI;
+         swappedOp = OP_JEQI;
+         break;
+      case OP_JNEQ: immediateOp = OP_JNEQI;
+         swappedOp = OP_JNEQI;
+         break;
+      case OP_JGR: immediateOp = OP_JGRI;
+         swappedOp = OP_JLSI;
+         break;
+      case OP_JGRE: immediateOp = OP_JGREI;
+         swappedOp = OP_JLSEI;
+         break;
+      case OP_JLS: immediateOp = OP_JLSI;
+         swappedOp = OP_JGRI;
+         break;
+      case OP_JLSE: immediateOp = OP_JLSEI;
+         swappedOp = OP_JGREI;
+         break;
+      default:
+         return 0;
+   }
+
+   if (node.right()->type == SyntaxTree::TYPE_NUMBER) {
+      op = immediateOp;
+      return node.left();
+   }
+   // subtraction and division are not commutative, nor are sum and product unless both operands are numbers ("3 * s" is an error
+   // while "s * 3" repeats the string s)
+   if (node.left()->type == SyntaxTree::TYPE_NUMBER && op != OP_SUB && op != OP_DIV &&
+           ((op != OP_ADD && op != OP_MUL) || isNumberExpression(*node.right()))) {
+      op = swappedOp;
+      return node.right();
+   }
+   return 0;
+}
+
+bool Compiler::isNumberExpression(const SyntaxTree& tree) const {
+   switch (tree.type) {
+      case SyntaxTree::TYPE_NUMBER:
+      case SyntaxTree::TYPE_DIFFERENCE:
+      case SyntaxTree::TYPE_DIVISION:
+         return true;
+      case SyntaxTree::TYPE_SUM:
+      case SyntaxTree::TYPE_PRODUCT:
+         return isNumberExpression(*tree.left()) && isNumberExpression(*tree.right());
+      default:
+         return false;
+   }
+}
+
 bool Compiler::findLocalName(const std::string& name, location_t & outLocation) const {
    size_t start = mActivationFramePointer.top();
    for (size_t i = start; i < mNamesStack.size(); ++i)
@@ -72,9 +72,21 @@ namespace ionscript {
       std::stack<bool> mVariableDeclarationAllowed;
       std::stack<std::vector<index_t>* > mContinues;
       std::stack<std::vector<index_t>* > mBreaks;
+      // end of the arguments windows of the calls being compiled, nested calls place their window above it
+      location_t mCallWindowEnd;
+      // first register usable by expressions whose target is not a register
+      location_t mFirstFreeRegister;
 
       int compile(const SyntaxTree& tree, BytecodeWriter& output, location_t target);
+      void compileExpressionNodeChild(const SyntaxTree& node, BytecodeWriter& output, location_t target, OpCode op);
       void compileExpressionNodeChildren(const SyntaxTree& node, BytecodeWriter& output, location_t target, OpCode op);
+      size_t compileConditionalJump(const SyntaxTree& condition, BytecodeWriter& output, location_t& target);
+      bool compileIncrement(const SyntaxTree& assignement, BytecodeWriter& output, location_t target);
+      void compileFunctionCall(const SyntaxTree& call, BytecodeWriter& output, location_t target, bool tailCall);
+      bool compileIntrinsic(const SyntaxTree& call, BytecodeWriter& output, location_t target, OpCode op);
+      bool isScriptFunction(const std::string& name) const;
+      const SyntaxTree* selectImmediateOpCode(const SyntaxTree& node, OpCode& op) const;
+      bool isNumberExpression(const SyntaxTree& tree) const;
 
       bool findLocalName(const std::string& name, location_t& outLocation) const;
       void deleteValues(size_t stackSize, BytecodeWriter& output, bool deleteNames);
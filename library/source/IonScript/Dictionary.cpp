@@ -0,0 +1,135 @@
+/*******************************************************************************
+ * IonScript                                                                   *
+ * (c) 2010-2011 Canio Massimo Tristano <massimo.tristano@gmail.com>           *
+ *                                                                             *
+ * This software is provided 'as-is', without any express or implied           *
+ * warranty. In no event will the authors be held liable for any damages       *
+ * arising from the use of this software.                                      *
+ *                                                                             *
+ * Permission is granted to anyone to use this software for any purpose,       *
+ * including commercial applications, and to alter it and redistribute it      *
+ * freely, subject to the following restrictions:                              *
+ *                                                                             *
+ * 1. The origin of this software must not be misrepresented; you must not     *
+ * claim that you wrote the original software. If you use this software        *
+ * in a product, an acknowledgment in the product documentation would be       *
+ * appreciated but is not required.                                            *
+ *                                                                             *
+ * 2. Altered source versions must be plainly marked as such, and must not be  *
+ * misrepresented as being the original software.                              *
+ *                                                                             *
+ * 3. This notice may not be removed or altered from any source                *
+ * distribution.                                                               *
+ ******************************************************************************/
+
+#include "Dictionary.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace ionscript;
+
+const int Dictionary::kEmptySlot;
+
+Dictionary::iterator Dictionary::find(const Value& key) {
+   if (mSlots.empty())
+      return mEntries.end();
+
+   int index = mSlots[findSlot(key, key.getHash())];
+   return (index == kEmptySlot) ? mEntries.end() : mEntries.begin() + index;
+}
+
+Dictionary::const_iterator Dictionary::find(const Value& key) const {
+   if (mSlots.empty())
+      return mEntries.end();
+
+   int index = mSlots[findSlot(key, key.getHash())];
+   return (index == kEmptySlot) ? mEntries.end() : mEntries.begin() + index;
+}
+
+Value & Dictionary::operator[](const Value& key) {
+   uint32_t hash = key.getHash();
+   if (!mSlots.empty()) {
+      int index = mSlots[findSlot(key, hash)];
+      if (index != kEmptySlot)
+         return mEntries[index].second;
+   }
+
+   // keep the load factor below 3/4
+   if ((mEntries.size() + 1) * 4 > mSlots.size() * 3)
+      rehash(max((size_t) 8, mSlots.size() * 2));
+
+   mSlots[findSlot(key, hash)] = mEntries.size();
+   mEntries.push_back(Entry(key, hash));
+   return mEntries.back().second;
+}
+
+size_t Dictionary::erase(const Value& key) {
+   iterator it = find(key);
+   if (it == mEntries.end())
+      return 0;
+
+   mEntries.erase(it);
+   rehash(mSlots.size());
+   return 1;
+}
+
+void Dictionary::clear() {
+   mEntries.clear();
+   mSlots.clear();
+}
+
+void Dictionary::reserve(size_t nEntries) {
+   size_t nSlots = 8;
+   while (nEntries * 4 > nSlots * 3)
+      nSlots *= 2;
+   if (nSlots > mSlots.size())
+      rehash(nSlots);
+   mEntries.reserve(nEntries);
+}
+
+void Dictionary::swap(Dictionary& other) {
+   mEntries.swap(other.mEntries);
+   mSlots.swap(other.mSlots);
+}
+
+bool Dictionary::operator==(const Dictionary& other) const {
+   if (size() != other.size())
+      return false;
+
+   for (const_iterator it = begin(); it != end(); ++it) {
+      const_iterator match = other.find(it->first);
+      if (match == other.end() || match->second != it->second)
+         return false;
+   }
+   return true;
+}
+
+size_t Dictionary::findSlot(const Value& key, uint32_t hash) const {
+   size_t mask = mSlots.size() - 1;
+   size_t slot = hash & mask;
+
+   while (true) {
+      int index = mSlots[slot];
+      if (index == kEmptySlot)
+         return slot;
+
+      const Entry& entry = mEntries[index];
+      if (entry.hash == hash && entry.first == key)
+         return slot;
+
+      slot = (slot + 1) & mask;
+   }
+}
+
+void Dictionary::rehash(size_t nSlots) {
+   mSlots.assign(nSlots, kEmptySlot);
+   size_t mask = nSlots - 1;
+
+   for (size_t i = 0; i < mEntries.size(); i++) {
+      size_t slot = mEntries[i].hash & mask;
+      while (mSlots[slot] != kEmptySlot)
+         slot = (slot + 1) & mask;
+      mSlots[slot] = i;
+   }
+}
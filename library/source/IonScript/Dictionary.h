@@ -0,0 +1,133 @@
+/*******************************************************************************
+ * IonScript                                                                   *
+ * (c) 2010-2011 Canio Massimo Tristano <massimo.tristano@gmail.com>           *
+ *                                                                             *
+ * This software is provided 'as-is', without any express or implied           *
+ * warranty. In no event will the authors be held liable for any damages       *
+ * arising from the use of this software.                                      *
+ *                                                                             *
+ * Permission is granted to anyone to use this software for any purpose,       *
+ * including commercial applications, and to alter it and redistribute it      *
+ * freely, subject to the following restrictions:                              *
+ *                                                                             *
+ * 1. The origin of this software must not be misrepresented; you must not     *
+ * claim that you wrote the original software. If you use this software        *
+ * in a product, an acknowledgment in the product documentation would be       *
+ * appreciated but is not required.                                            *
+ *                                                                             *
+ * 2. Altered source versions must be plainly marked as such, and must not be  *
+ * misrepresented as being the original software.                              *
+ *                                                                             *
+ * 3. This notice may not be removed or altered from any source                *
+ * distribution.                                                               *
+ ******************************************************************************/
+
+#ifndef ION_SCRIPT_DICTIONARY_H
+#define	ION_SCRIPT_DICTIONARY_H
+
+#include "Typedefs.h"
+#include "Value.h"
+
+#include <vector>
+#include <stdint.h>
+
+namespace ionscript {
+
+   /**
+    * The dictionary type of scripts. It is an open-addressing hash table with linear probing whose slots index an array of
+    * entries kept in insertion order: iterating a dictionary always visits its keys in the order they were first inserted, hence
+    * Value::toString() output is deterministic. Keys are hashed by Value::getHash() and compared by Value::operator==.
+    * @remark iterators and references to values are invalidated by insertions and removals, as for std::vector.
+    * @remark do not modify keys through iterators.
+    */
+   class Dictionary {
+   public:
+      /**
+       * A key-value pair. Members are named after std::pair so that it can be used as std::map entries were.
+       */
+      struct Entry {
+         Entry(const Value& key, uint32_t keyHash) : first(key), hash(keyHash) { }
+
+         Value first;
+         Value second;
+         /** Cached hash of the key. */
+         uint32_t hash;
+      };
+
+      typedef std::vector<Entry>::iterator iterator;
+      typedef std::vector<Entry>::const_iterator const_iterator;
+
+      inline iterator begin() {
+         return mEntries.begin();
+      }
+      inline const_iterator begin() const {
+         return mEntries.begin();
+      }
+      inline iterator end() {
+         return mEntries.end();
+      }
+      inline const_iterator end() const {
+         return mEntries.end();
+      }
+      inline size_t size() const {
+         return mEntries.size();
+      }
+      inline bool empty() const {
+         return mEntries.empty();
+      }
+      /**
+       * @return an iterator to the entry with given key, end() if there is none.
+       */
+      iterator find(const Value& key);
+      const_iterator find(const Value& key) const;
+      /**
+       * @return 1 if given key is in the dictionary, 0 otherwise.
+       */
+      inline size_t count(const Value& key) const {
+         return (find(key) != end()) ? 1 : 0;
+      }
+      /**
+       * @return the value associated with given key. If the key is not found, it is inserted with a nil value.
+       */
+      Value & operator[](const Value& key);
+      /**
+       * Removes the entry with given key, preserving the order of the others. It takes linear time.
+       * @return the number of removed entries.
+       */
+      size_t erase(const Value& key);
+      void clear();
+      /**
+       * Prepares the dictionary for given number of entries so that inserting them does not grow the table.
+       */
+      void reserve(size_t nEntries);
+      void swap(Dictionary& other);
+
+      /**
+       * @return true if both dictionaries contain equal keys associated with equal values, regardless of the insertion order.
+       */
+      bool operator==(const Dictionary& other) const;
+      inline bool operator!=(const Dictionary& other) const {
+         return !(*this == other);
+      }
+
+   private:
+      /** Entries in insertion order. */
+      std::vector<Entry> mEntries;
+      /** Hash table of indices into mEntries, kEmptySlot if free. Its size is zero or a power of two. */
+      std::vector<int> mSlots;
+
+      static const int kEmptySlot = -1;
+
+      /**
+       * @return the slot holding given key or, if the key is not present, the free slot where it should be inserted.
+       */
+      size_t findSlot(const Value& key, uint32_t hash) const;
+      /**
+       * Rebuilds the table with given number of slots.
+       */
+      void rehash(size_t nSlots);
+   };
+}
+
+#endif	/* ION_SCRIPT_DICTIONARY_H */
+
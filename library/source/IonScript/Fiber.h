@@ -0,0 +1,99 @@
+/*******************************************************************************
+ * IonScript                                                                   *
+ * (c) 2010-2011 Canio Massimo Tristano <massimo.tristano@gmail.com>           *
+ *                                                                             *
+ * This software is provided 'as-is', without any express or implied           *
+ * warranty. In no event will the authors be held liable for any damages       *
+ * arising from the use of this software.                                      *
+ *                                                                             *
+ * Permission is granted to anyone to use this software for any purpose,       *
+ * including commercial applications, and to alter it and redistribute it      *
+ * freely, subject to the following restrictions:                              *
+ *                                                                             *
+ * 1. The origin of this software must not be misrepresented; you must not     *
+ * claim that you wrote the original software. If you use this software        *
+ * in a product, an acknowledgment in the product documentation would be       *
+ * appreciated but is not required.                                            *
+ *                                                                             *
+ * 2. Altered source versions must be plainly marked as such, and must not be  *
+ * misrepresented as being the original software.                              *
+ *                                                                             *
+ * 3. This notice may not be removed or altered from any source                *
+ * distribution.                                                               *
+ ******************************************************************************/
+
+#ifndef ION_SCRIPT_FIBER_H
+#define	ION_SCRIPT_FIBER_H
+
+#include "Typedefs.h"
+#include "Value.h"
+#include "ValueStack.h"
+#include "VirtualMachine.h"
+
+#include <vector>
+
+namespace ionscript {
+
+   /**
+    * A script coroutine: a call to a script function of the loaded program with its own values stack and activation frames,
+    * which can be suspended and resumed independently of the program and of the other fibers. Fibers are created by
+    * VirtualMachine::createFiber() and run by VirtualMachine::resume() until the function returns or a host function suspends
+    * them: a function registered with maySuspend that returns no value makes the fiber wait until VirtualMachine::resume() is
+    * given the value, pause() makes it wait for a plain resume(). Thousands of suspended fibers can be multiplexed on one thread.
+    * Fibers share the global functions of the program, they are invalidated by running another program.
+    */
+   class Fiber {
+      friend class VirtualMachine;
+
+   public:
+      ~Fiber() { }
+      /**
+       * @return STATE_PAUSED if the fiber can be resumed, STATE_WAITING_FOR_RETURN if it waits for the value of a host function,
+       *       STATE_RUNNING while it runs and STATE_FINISHED once the function returned or raised an error.
+       */
+      inline VirtualMachine::State getState() const {
+         return mActive ? VirtualMachine::STATE_RUNNING : mState;
+      }
+      /**
+       * @return whether the function returned or raised an error.
+       */
+      inline bool isFinished() const {
+         return getState() == VirtualMachine::STATE_FINISHED;
+      }
+      /**
+       * @return the value returned by the function once the fiber is finished, nil before.
+       */
+      inline const Value& getResult() const {
+         return mResult;
+      }
+
+   private:
+      Fiber(size_t stackCapacity, unsigned int runID);
+
+      /*
+       * The execution state, swapped with the one of the VirtualMachine while the fiber runs.
+       */
+      ValueStack mValues;
+      std::vector<VirtualMachine::ActivationRecord> mActivations;
+      index_t mIP;
+      VirtualMachine::State mState;
+      size_t mHostFunctionArgumentsCount;
+      size_t mHostFunctionReturnLocation;
+
+      /** The value returned by the function. */
+      Value mResult;
+      /** The value to return to the suspended host function call when the fiber is resumed. */
+      Value mPendingResult;
+      /** Whether mPendingResult is to be returned to the suspended host function call. */
+      bool mHasPendingResult;
+      /** Whether the fiber is running: its execution state is in the VirtualMachine. */
+      bool mActive;
+      /** The run of the VirtualMachine the fiber was created in. */
+      unsigned int mRunID;
+
+      Fiber(const Fiber&);
+      Fiber& operator=(const Fiber&);
+   };
+}
+
+#endif	/* ION_SCRIPT_FIBER_H */
@@ -33,11 +33,6 @@
 using namespace std;
 using namespace ionscript;
 
-FunctionCallManager::FunctionCallManager(VirtualMachine& vm, FunctionID functionID, const Value* pArguments, size_t argumentsCount)
-: mVM(vm), mFunctionID(functionID), mpArguments(pArguments), mArgumentsCount(argumentsCount) { }
-
-FunctionCallManager::~FunctionCallManager() { }
-
 void FunctionCallManager::assertArgumentType(size_t index, int type) const {
    if (!(getArgument(index).getType() & type)) {
       stringstream ss;
@@ -70,22 +65,6 @@ void FunctionCallManager::assertArgumentObjectType(size_t index, const std::type
    }
 }
 
-void FunctionCallManager::returnNil() const {
-   mVM.returnValue(Value());
-}
-
-void FunctionCallManager::returnBoolean(bool value) const {
-   mVM.returnValue(Value(value));
-}
-
-void FunctionCallManager::returnNumber(double value) const {
-   mVM.returnValue(Value(value));
-}
-
-void FunctionCallManager::returnString(const std::string& value) const {
-   mVM.returnValue(Value(value));
-}
-
-void FunctionCallManager::returnValue(const Value& value) const {
-   mVM.returnValue(value);
+void FunctionCallManager::returnToSuspendedCall(const Value& value) const {
+   mVM.returnValue(value, mpFiber);
 }
@@ -42,7 +42,7 @@ namespace ionscript {
       friend class VirtualMachine;
 
    public:
-      virtual ~FunctionCallManager();
+      virtual ~FunctionCallManager() { }
       /**
        * @return the actual called function ID.
        */
@@ -70,6 +70,12 @@ namespace ionscript {
       inline VirtualMachine& getVM() const {
          return mVM;
       }
+      /**
+       * @return the fiber that made this call, 0 if it was made by the program.
+       */
+      inline Fiber* getFiber() const {
+         return mpFiber;
+      }
       /**
        * Asserts that a specified argument at position index has an allowed type. It returns silently if the assertion succeeds.
        * @param index index of the argument to check in the vector of passed arguments.
@@ -89,22 +95,30 @@ namespace ionscript {
       /**
        * The called function returns nil and the execution immediately continues when the host function group returns.
        */
-      void returnNil() const;
+      inline void returnNil() const {
+         returnValue(Value());
+      }
       /**
        * The called function returns a number and the execution immediately continues when the host function group returns.
        * @param value number to return.
        */
-      void returnNumber(double value) const;
+      inline void returnNumber(double value) const {
+         returnValue(Value(value));
+      }
       /**
        * The called function returns a boolean value and the execution immediately continues when the host function group returns.
        * @param value boolean value to return.
        */
-      void returnBoolean(bool value) const;
+      inline void returnBoolean(bool value) const {
+         returnValue(Value(value));
+      }
       /**
        * The called function returns a string and the execution immediately continues when the host function group returns.
        * @param value string to return.
        */
-      void returnString(const std::string& value) const;
+      inline void returnString(const std::string& value) const {
+         returnValue(Value(value));
+      }
       /**
        * The called function returns an object.
        * @param object reference to the object to be returned.
@@ -116,20 +130,35 @@ namespace ionscript {
       }
       /**
        * The called function returns a certain Value and the execution immediately continues when the host function group returns.
+       * A function that returns nothing returns nil, unless it has been registered as one that may suspend the VM (see
+       * VirtualMachine::setFunction()): the VM then waits until a copy of this manager returns a value and goOn() is called.
        * @param value Value to return.
        */
-      void returnValue(const Value& value) const;
+      inline void returnValue(const Value& value) const {
+         if (mpResult)
+            *mpResult = value;
+         else
+            returnToSuspendedCall(value);
+      }
 
    private:
       /**
        * Only VirtualMachine creates new FunctionCallManager when the script calls a host function.
+       * @param pResult where the returned value is stored, 0 for functions that may suspend the VM, whose value is returned through
+       *       the VM state machine.
+       * @param pFiber the calling fiber, 0 for the program.
        */
-      FunctionCallManager(VirtualMachine &vm, FunctionID functionID, const Value* pArguments, size_t argumentsCount);
+      FunctionCallManager(VirtualMachine &vm, FunctionID functionID, const Value* pArguments, size_t argumentsCount, Value* pResult, Fiber* pFiber)
+      : mVM(vm), mFunctionID(functionID), mpArguments(pArguments), mArgumentsCount(argumentsCount), mpResult(pResult), mpFiber(pFiber) { }
+
+      void returnToSuspendedCall(const Value& value) const;
 
       VirtualMachine& mVM;
       FunctionID mFunctionID;
       const Value* mpArguments;
       size_t mArgumentsCount;
+      Value* mpResult;
+      Fiber* mpFiber;
    };
 
 }
@@ -0,0 +1,278 @@
+/*******************************************************************************
+ * IonScript                                                                   *
+ * (c) 2010-2011 Canio Massimo Tristano <massimo.tristano@gmail.com>           *
+ *                                                                             *
+ * This software is provided 'as-is', without any express or implied           *
+ * warranty. In no event will the authors be held liable for any damages       *
+ * arising from the use of this software.                                      *
+ *                                                                             *
+ * Permission is granted to anyone to use this software for any purpose,       *
+ * including commercial applications, and to alter it and redistribute it      *
+ * freely, subject to the following restrictions:                              *
+ *                                                                             *
+ * 1. The origin of this software must not be misrepresented; you must not     *
+ * claim that you wrote the original software. If you use this software        *
+ * in a product, an acknowledgment in the product documentation would be       *
+ * appreciated but is not required.                                            *
+ *                                                                             *
+ * 2. Altered source versions must be plainly marked as such, and must not be  *
+ * misrepresented as being the original software.                              *
+ *                                                                             *
+ * 3. This notice may not be removed or altered from any source                *
+ * distribution.                                                               *
+ ******************************************************************************/
+
+#ifndef ION_SCRIPT_HOST_BINDING_H
+#define	ION_SCRIPT_HOST_BINDING_H
+
+#include "Array.h"
+#include "Value.h"
+
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace ionscript {
+
+   /**
+    * Converts values to the C++ types of the parameters of bound host functions (from()) and their results back to values (to()).
+    * from() throws a RuntimeError if the value has not the expected type. Types without a specialization cannot be bound, so
+    * mismatches are caught at compile time.
+    */
+   template <typename T>
+   struct ValueConverter;
+
+   template <>
+   struct ValueConverter<double> {
+      static inline double from(const Value& value) {
+         return value.getNumberSafely();
+      }
+      static inline Value to(double value) {
+         return Value(value);
+      }
+   };
+
+   template <>
+   struct ValueConverter<float> {
+      static inline float from(const Value& value) {
+         return (float) value.getNumberSafely();
+      }
+      static inline Value to(float value) {
+         return Value((double) value);
+      }
+   };
+
+   template <>
+   struct ValueConverter<int> {
+      static inline int from(const Value& value) {
+         return value.getIntegerSafely();
+      }
+      static inline Value to(int value) {
+         return Value(value);
+      }
+   };
+
+   template <>
+   struct ValueConverter<unsigned int> {
+      static inline unsigned int from(const Value& value) {
+         return value.getPositiveIntegerSafely();
+      }
+      static inline Value to(unsigned int value) {
+         return Value((double) value);
+      }
+   };
+
+   template <>
+   struct ValueConverter<bool> {
+      static inline bool from(const Value& value) {
+         return value.getBooleanSafely();
+      }
+      static inline Value to(bool value) {
+         return Value(value);
+      }
+   };
+
+   template <>
+   struct ValueConverter<std::string> {
+      static inline const std::string& from(const Value& value) {
+         return value.getStringSafely();
+      }
+      static inline Value to(const std::string& value) {
+         return Value(value);
+      }
+   };
+
+   template <>
+   struct ValueConverter<const char*> {
+      static inline const char* from(const Value& value) {
+         return value.getStringSafely().c_str();
+      }
+      static inline Value to(const char* value) {
+         return Value(value);
+      }
+   };
+
+   template <>
+   struct ValueConverter<Value> {
+      static inline const Value& from(const Value& value) {
+         return value;
+      }
+      static inline const Value& to(const Value& value) {
+         return value;
+      }
+   };
+
+   template <>
+   struct ValueConverter<List> {
+      static inline List& from(const Value& value) {
+         return value.getListSafely();
+      }
+   };
+
+   template <>
+   struct ValueConverter<Dictionary> {
+      static inline Dictionary& from(const Value& value) {
+         return value.getDictionarySafely();
+      }
+   };
+
+   /**
+    * Typed arrays are passed by reference or by pointer. A returned array becomes managed by the VM, which never deletes the host
+    * elements of the array though.
+    */
+   template <>
+   struct ValueConverter<Array> {
+      static inline Array& from(const Value& value) {
+         return value.getArraySafely();
+      }
+   };
+
+   template <>
+   struct ValueConverter<Array*> {
+      static inline Array* from(const Value& value) {
+         return &value.getArraySafely();
+      }
+      static inline Value to(Array* pArray) {
+         return Value(pArray);
+      }
+   };
+
+   /**
+    * User objects are passed by pointer. Returned pointers are not managed by the VM.
+    */
+   template <typename T>
+   struct ValueConverter<T*> {
+      static inline T* from(const Value& value) {
+         return value.getObjectSafely<T > ();
+      }
+      static inline Value to(T* pObject) {
+         return Value(pObject);
+      }
+   };
+
+   /**
+    * A host function bound to a script name by VirtualMachine::bind(). The compiler already checked the number of arguments, the
+    * binding converts them, calls the function and stores its result straight into the target value.
+    */
+   class HostBinding {
+   public:
+      virtual ~HostBinding() { }
+      /**
+       * @param arguments the arguments given by the script.
+       * @param result where the returned value is stored.
+       * @throw RuntimeError if an argument has not the type of the corresponding parameter.
+       */
+      virtual void call(const Value* arguments, Value& result) = 0;
+   };
+
+   /** The indices of the arguments of a bound function, unpacked along with the parameter types. */
+   template <size_t... I>
+   struct ArgumentIndices { };
+
+   template <size_t N, size_t... I>
+   struct MakeArgumentIndices : MakeArgumentIndices<N - 1, N - 1, I...> { };
+
+   template <size_t... I>
+   struct MakeArgumentIndices<0, I...> {
+      typedef ArgumentIndices<I...> Type;
+   };
+
+   /**
+    * Calls a bound function and stores what it returns, nil for void functions.
+    */
+   template <typename R>
+   struct BoundCall {
+      template <typename F, typename... A>
+      static inline void store(Value& result, const F& function, A&&... arguments) {
+         result = ValueConverter<typename std::decay<R>::type>::to(function(std::forward<A>(arguments)...));
+      }
+   };
+
+   template <>
+   struct BoundCall<void> {
+      template <typename F, typename... A>
+      static inline void store(Value& result, const F& function, A&&... arguments) {
+         function(std::forward<A>(arguments)...);
+         result.setNil();
+      }
+   };
+
+   /**
+    * Binding of a free function (or a static member function).
+    */
+   template <typename R, typename... Args>
+   class FunctionBinding : public HostBinding {
+   public:
+      typedef R(*Function)(Args...);
+
+      explicit FunctionBinding(Function function) : mFunction(function) { }
+
+      virtual void call(const Value* arguments, Value& result) {
+         invoke(arguments, result, typename MakeArgumentIndices<sizeof...(Args)>::Type());
+      }
+
+   private:
+      Function mFunction;
+
+      template <size_t... I>
+      inline void invoke(const Value* arguments, Value& result, ArgumentIndices<I...>) {
+         BoundCall<R>::store(result, mFunction, ValueConverter<typename std::decay<Args>::type>::from(arguments[I])...);
+      }
+   };
+
+   /**
+    * Binding of a member function to the object it is called on, which must outlive the VirtualMachine.
+    */
+   template <typename C, typename M, typename R, typename... Args>
+   class MethodBinding : public HostBinding {
+   public:
+      MethodBinding(M method, C* pObject) : mMethod(method), mpObject(pObject) { }
+
+      virtual void call(const Value* arguments, Value& result) {
+         invoke(arguments, result, typename MakeArgumentIndices<sizeof...(Args)>::Type());
+      }
+
+   private:
+      M mMethod;
+      C* mpObject;
+
+      struct Caller {
+         M method;
+         C* pObject;
+
+         template <typename... A>
+         inline R operator()(A&&... arguments) const {
+            return (pObject->*method)(std::forward<A>(arguments)...);
+         }
+      };
+
+      template <size_t... I>
+      inline void invoke(const Value* arguments, Value& result, ArgumentIndices<I...>) {
+         Caller caller = {mMethod, mpObject};
+         BoundCall<R>::store(result, caller, ValueConverter<typename std::decay<Args>::type>::from(arguments[I])...);
+      }
+   };
+}
+
+#endif	/* ION_SCRIPT_HOST_BINDING_H */
+
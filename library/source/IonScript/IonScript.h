@@ -25,12 +25,19 @@
 #ifndef ION_SCRIPT_H
 #define	ION_SCRIPT_H
 
+#include "Allocator.h"
+#include "Array.h"
 #include "Exceptions.h"
 #include "Bytecode.h"
 #include "Compiler.h"
+#include "Collector.h"
+#include "Dictionary.h"
+#include "Fiber.h"
 #include "FunctionCallManager.h"
+#include "HostBinding.h"
 #include "VirtualMachine.h"
 #include "Parser.h"
+#include "Program.h"
 #include "Typedefs.h"
 #include "OpCode.h"
 #include "SyntaxTree.h"
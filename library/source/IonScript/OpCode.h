@@ -51,19 +51,6 @@ namespace ionscript {
        */
       OP_PUSH,
 
-      /**
-       * push.val <location_t: target>
-       * Pushes value at <target> onto the value-stack.
-       */
-      OP_PUSH_VAL,
-
-
-      /**
-       * pop.to <location_t: target>
-       * Copies the most recent Value on the value-stack to <target>, then it pops.
-       */
-      OP_POP_TO,
-
       /**
        * push.n <double: value>
        * Pushes the number <value> on the Value stack
@@ -136,6 +123,42 @@ namespace ionscript {
        */
       OP_DIV,
 
+      /**
+       * inc <location_t: target>, <double: number>
+       * Adds the constant <number> to value at location <target>.
+       */
+      OP_INC,
+
+      /**
+       * dec <location_t: target>, <double: number>
+       * Subtracts the constant <number> from value at location <target>.
+       */
+      OP_DEC,
+
+      /**
+       * addi <location_t: target>, <location_t: source>, <double: number>
+       * Adds the constant <number> to value at location <source> and puts the result in <target>.
+       */
+      OP_ADDI,
+
+      /**
+       * subi <location_t: target>, <location_t: source>, <double: number>
+       * Subtracts the constant <number> from value at location <source> and puts the result in <target>.
+       */
+      OP_SUBI,
+
+      /**
+       * muli <location_t: target>, <location_t: source>, <double: number>
+       * Multiplies value at location <source> by the constant <number> and puts the result in <target>.
+       */
+      OP_MULI,
+
+      /**
+       * divi <location_t: target>, <location_t: source>, <double: number>
+       * Divides value at location <source> by the constant <number> and puts the result in <target>.
+       */
+      OP_DIVI,
+
       /**
        * not <location_t: target>, <location_t: source>
        * Logically negates value a location <source> and puts the result in <target>
@@ -190,6 +213,42 @@ namespace ionscript {
        */
       OP_LSE,
 
+      /**
+       * eqi <location_t: target>, <location_t: source>, <double: number>
+       * Puts the result of the "==" operation between <source> and the constant <number> in <target>.
+       */
+      OP_EQI,
+
+      /**
+       * neqi <location_t: target>, <location_t: source>, <double: number>
+       * Puts the result of the "!=" operation between <source> and the constant <number> in <target>.
+       */
+      OP_NEQI,
+
+      /**
+       * gri <location_t: target>, <location_t: source>, <double: number>
+       * Puts the result of the ">" operation between <source> and the constant <number> in <target>.
+       */
+      OP_GRI,
+
+      /**
+       * grei <location_t: target>, <location_t: source>, <double: number>
+       * Puts the result of the ">=" operation between <source> and the constant <number> in <target>.
+       */
+      OP_GREI,
+
+      /**
+       * lsi <location_t: target>, <location_t: source>, <double: number>
+       * Puts the result of the "<" operation between <source> and the constant <number> in <target>.
+       */
+      OP_LSI,
+
+      /**
+       * lsei <location_t: target>, <location_t: source>, <double: number>
+       * Puts the result of the "<=" operation between <source> and the constant <number> in <target>.
+       */
+      OP_LSEI,
+
       /**
        * jump <index_t: index>
        * Sets the Instruction Pointer to index.
@@ -202,6 +261,78 @@ namespace ionscript {
        */
       OP_JUMP_COND,
 
+      /**
+       * jeq <location_t: first>, <location_t: second>, <index_t: index>
+       * Sets the Instruction Pointer to index if the "==" operation between <first> and <second> is false.
+       */
+      OP_JEQ,
+
+      /**
+       * jneq <location_t: first>, <location_t: second>, <index_t: index>
+       * Sets the Instruction Pointer to index if the "!=" operation between <first> and <second> is false.
+       */
+      OP_JNEQ,
+
+      /**
+       * jgr <location_t: first>, <location_t: second>, <index_t: index>
+       * Sets the Instruction Pointer to index if the ">" operation between <first> and <second> is false.
+       */
+      OP_JGR,
+
+      /**
+       * jgre <location_t: first>, <location_t: second>, <index_t: index>
+       * Sets the Instruction Pointer to index if the ">=" operation between <first> and <second> is false.
+       */
+      OP_JGRE,
+
+      /**
+       * jls <location_t: first>, <location_t: second>, <index_t: index>
+       * Sets the Instruction Pointer to index if the "<" operation between <first> and <second> is false.
+       */
+      OP_JLS,
+
+      /**
+       * jlse <location_t: first>, <location_t: second>, <index_t: index>
+       * Sets the Instruction Pointer to index if the "<=" operation between <first> and <second> is false.
+       */
+      OP_JLSE,
+
+      /**
+       * jeqi <location_t: source>, <double: number>, <index_t: index>
+       * Sets the Instruction Pointer to index if the "==" operation between <source> and the constant <number> is false.
+       */
+      OP_JEQI,
+
+      /**
+       * jneqi <location_t: source>, <double: number>, <index_t: index>
+       * Sets the Instruction Pointer to index if the "!=" operation between <source> and the constant <number> is false.
+       */
+      OP_JNEQI,
+
+      /**
+       * jgri <location_t: source>, <double: number>, <index_t: index>
+       * Sets the Instruction Pointer to index if the ">" operation between <source> and the constant <number> is false.
+       */
+      OP_JGRI,
+
+      /**
+       * jgrei <location_t: source>, <double: number>, <index_t: index>
+       * Sets the Instruction Pointer to index if the ">=" operation between <source> and the constant <number> is false.
+       */
+      OP_JGREI,
+
+      /**
+       * jlsi <location_t: source>, <double: number>, <index_t: index>
+       * Sets the Instruction Pointer to index if the "<" operation between <source> and the constant <number> is false.
+       */
+      OP_JLSI,
+
+      /**
+       * jlsei <location_t: source>, <double: number>, <index_t: index>
+       * Sets the Instruction Pointer to index if the "<=" operation between <source> and the constant <number> is false.
+       */
+      OP_JLSEI,
+
       /**
        * ret.nil
        * Destroyes the funciton-call structure, restores the IP to the previous index and pushes nil into the value-stack.
@@ -214,33 +345,56 @@ namespace ionscript {
        */
       OP_RETURN,
       /**
-       * pcall_sf.g <location:t target>
-       * Prepares the call of the global function at <target>. It simply pushes the necessary registers onto the value-stack.
+       * call_sf.g <location_t: function>, <location_t: window>, <small_size_t: arguments_count>, <location_t: target>
+       * Calls the function GLOBALLY located at <function> with the <argument_count> arguments stored from location <window>
+       * on, which must be above all the values of the caller. The callee's frame is built in place over the arguments and
+       * the returned value is stored in <target>.
        */
-      OP_PCALL_SF_G,
+      OP_CALL_SF_G,
+
       /**
-       * pcall_sf.l <location:t target>
-       * Prepares the call of the local function at <target>. It simply pushes the necessary registers onto the value-stack.
+       * call_sf.l <location_t: function>, <location_t: window>, <small_size_t: arguments_count>, <location_t: target>
+       * Calls the function LOCALLY located at <function> with the <argument_count> arguments stored from location <window>
+       * on, which must be above all the values of the caller. The callee's frame is built in place over the arguments and
+       * the returned value is stored in <target>.
        */
-      OP_PCALL_SF_L,
+      OP_CALL_SF_L,
+
       /**
-       * call_sf.g <location_t: function>, <small_size_t: arguments_count>
-       * Calls the function GLOBALLY located at <function> with <argument_count> arguments pushed previously.
+       * tcall_sf.g <location_t: function>, <location_t: window>, <small_size_t: arguments_count>
+       * Tail call: like call_sf.g, but the frame of the calling function is replaced by the callee's one, which returns
+       * directly to the caller of the current function.
        */
-      OP_CALL_SF_G,
+      OP_TAIL_CALL_SF_G,
 
       /**
-       * call_sf.l <location_t: function>, <small_size_t: arguments_count>
-       * Calls the function LOCALLY located at <function> with <argument_count> arguments pushed previously.
+       * tcall_sf.l <location_t: function>, <location_t: window>, <small_size_t: arguments_count>
+       * Tail call: like call_sf.l, but the frame of the calling function is replaced by the callee's one, which returns
+       * directly to the caller of the current function.
        */
-      OP_CALL_SF_L,
+      OP_TAIL_CALL_SF_L,
 
       /**
-       * call_hf <HostFunctionGroupID: hfgID>, <FunctionID: fID>, <small_size_t: arguments_count>
-       * Calls the host function group <hfgID> passing the function ID <fID> with <arguments_count> arguments pushed previously.
+       * call_hf <HostFunctionGroupID: hfgID>, <FunctionID: fID>, <location_t: window>, <small_size_t: arguments_count>, <location_t: target>
+       * Calls the host function group <hfgID> passing the function ID <fID> with the <arguments_count> arguments stored from
+       * location <window> on. The returned value is stored in <target>, nil if the function returns none.
        */
       OP_CALL_HF,
 
+      /**
+       * call_hf.s <HostFunctionGroupID: hfgID>, <FunctionID: fID>, <location_t: window>, <small_size_t: arguments_count>, <location_t: target>
+       * Like call_hf, for functions that may suspend the VM: the value is returned through the VM state machine, possibly after
+       * the host function group returned.
+       */
+      OP_CALL_HF_S,
+
+      /**
+       * call_bf <index_t: binding>, <location_t: window>, <small_size_t: arguments_count>, <location_t: target>
+       * Calls the host function bound with VirtualMachine::bind() <binding> with the <arguments_count> arguments stored from
+       * location <window> on. The returned value is stored in <target>.
+       */
+      OP_CALL_BF,
+
       /**
        * list.new <location_t: target>
        * Sets the value at location <target> as a new list.
@@ -267,7 +421,8 @@ namespace ionscript {
 
       /**
        * get <location_t: target>, <location_t: cont>, <location_t: index>
-       * Sets the value contained in container at location <cont> with index/key <index> into the value at location <target>
+       * Sets the value contained in container at location <cont> with index/key <index> into the value at location <target>.
+       * The container is a list, a dictionary or a typed array.
        */
       OP_GET,
 
@@ -276,6 +431,143 @@ namespace ionscript {
        * Sets the value at location <target> to value with index/key at <index> within the container at location <cont>.
        */
       OP_SET,
+
+      /**
+       * slice <location_t: target>, <location_t: cont>, <location_t: begin>, <location_t: end>
+       * Sets the value at location <target> to a new list, string or typed array holding the elements of the one at location
+       * <cont> from index <begin> up to index <end> excluded. A nil bound stands for the beginning or the end.
+       */
+      OP_SLICE,
+
+      /*
+       * Intrinsics. The Compiler emits them in place of calls to the builtin functions with the same name, as long as the name
+       * is not bound to a script or a different host function.
+       */
+
+      /**
+       * len <location_t: target>, <location_t: source>
+       * Puts the length of the string, list, dictionary or typed array at location <source> in <target>.
+       */
+      OP_LEN,
+
+      /**
+       * append <location_t: target>, <location_t: list>, <location_t: value>
+       * Appends the value at location <value> to the list at location <list>, which is then put in <target>.
+       */
+      OP_APPEND,
+
+      /**
+       * floor <location_t: target>, <location_t: source>
+       * Puts the largest integer not greater than the number at location <source> in <target>.
+       */
+      OP_FLOOR,
+
+      /**
+       * sqrt <location_t: target>, <location_t: source>
+       * Puts the square root of the number at location <source> in <target>.
+       */
+      OP_SQRT,
+
+      /**
+       * abs <location_t: target>, <location_t: source>
+       * Puts the absolute value of the number at location <source> in <target>.
+       */
+      OP_ABS,
+
+      /**
+       * min <location_t: target>, <location_t: first>, <location_t: second>
+       * Puts the smaller between the numbers at locations <first> and <second> in <target>.
+       */
+      OP_MIN,
+
+      /**
+       * max <location_t: target>, <location_t: first>, <location_t: second>
+       * Puts the greater between the numbers at locations <first> and <second> in <target>.
+       */
+      OP_MAX,
+
+      /**
+       * halt
+       * Terminates the execution of the program.
+       */
+      OP_HALT,
+
+      /*
+       * Quickened op-codes. The Compiler never emits them and the Program rejects them: the VirtualMachine rewrites a generic
+       * instruction into its quickened version once it finds both operands are numbers, and rewrites it back as soon as they are not.
+       */
+
+      /**
+       * add.nn <location_t: target>, <location_t: first>, <location_t: second>
+       * Same as add when both <first> and <second> are numbers.
+       */
+      OP_ADD_NN,
+
+      /**
+       * sub.nn <location_t: target>, <location_t: first>, <location_t: second>
+       * Same as sub when both <first> and <second> are numbers.
+       */
+      OP_SUB_NN,
+
+      /**
+       * mul.nn <location_t: target>, <location_t: first>, <location_t: second>
+       * Same as mul when both <first> and <second> are numbers.
+       */
+      OP_MUL_NN,
+
+      /**
+       * div.nn <location_t: target>, <location_t: first>, <location_t: second>
+       * Same as div when both <first> and <second> are numbers.
+       */
+      OP_DIV_NN,
+
+      /**
+       * gr.nn <location_t: target>, <location_t: first>, <location_t: second>
+       * Same as gr when both <first> and <second> are numbers.
+       */
+      OP_GR_NN,
+
+      /**
+       * gre.nn <location_t: target>, <location_t: first>, <location_t: second>
+       * Same as gre when both <first> and <second> are numbers.
+       */
+      OP_GRE_NN,
+
+      /**
+       * ls.nn <location_t: target>, <location_t: first>, <location_t: second>
+       * Same as ls when both <first> and <second> are numbers.
+       */
+      OP_LS_NN,
+
+      /**
+       * lse.nn <location_t: target>, <location_t: first>, <location_t: second>
+       * Same as lse when both <first> and <second> are numbers.
+       */
+      OP_LSE_NN,
+
+      /**
+       * jgr.nn <location_t: first>, <location_t: second>, <index_t: index>
+       * Same as jgr when both <first> and <second> are numbers.
+       */
+      OP_JGR_NN,
+
+      /**
+       * jgre.nn <location_t: first>, <location_t: second>, <index_t: index>
+       * Same as jgre when both <first> and <second> are numbers.
+       */
+      OP_JGRE_NN,
+
+      /**
+       * jls.nn <location_t: first>, <location_t: second>, <index_t: index>
+       * Same as jls when both <first> and <second> are numbers.
+       */
+      OP_JLS_NN,
+
+      /**
+       * jlse.nn <location_t: first>, <location_t: second>, <index_t: index>
+       * Same as jlse when both <first> and <second> are numbers.
+       */
+      OP_JLSE_NN,
    };
 }
 #endif	/* ION_SCRIPT_OPCODE_H */
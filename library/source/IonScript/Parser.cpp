@@ -449,7 +449,22 @@ void Parser::dereference(SyntaxTree& tree) {
       tree.copyOnNewChild();
       tree.type = SyntaxTree::TYPE_CONTAINER_ELEMENT;
 
-      mathExpression(*tree.createChild());
+      // a[i:j] slices the container, either bound may be omitted
+      if (accept(Lexer::T_COLON)) {
+         tree.type = SyntaxTree::TYPE_SLICE;
+         tree.createChild()->type = SyntaxTree::TYPE_NIL;
+      } else {
+         mathExpression(*tree.createChild());
+         if (accept(Lexer::T_COLON))
+            tree.type = SyntaxTree::TYPE_SLICE;
+      }
+
+      if (tree.type == SyntaxTree::TYPE_SLICE) {
+         if (mTokenType == Lexer::T_RIGHT_SQUARE_BRACKET)
+            tree.createChild()->type = SyntaxTree::TYPE_NIL;
+         else
+            mathExpression(*tree.createChild());
+      }
       expect(Lexer::T_RIGHT_SQUARE_BRACKET);
    }
 }
@@ -0,0 +1,328 @@
+/*******************************************************************************
+ * IonScript                                                                   *
+ * (c) 2010-2011 Canio Massimo Tristano <massimo.tristano@gmail.com>           *
+ *                                                                             *
+ * This software is provided 'as-is', without any express or implied           *
+ * warranty. In no event will the authors be held liable for any damages       *
+ * arising from the use of this software.                                      *
+ *                                                                             *
+ * Permission is granted to anyone to use this software for any purpose,       *
+ * including commercial applications, and to alter it and redistribute it      *
+ * freely, subject to the following restrictions:                              *
+ *                                                                             *
+ * 1. The origin of this software must not be misrepresented; you must not     *
+ * claim that you wrote the original software. If you use this software        *
+ * in a product, an acknowledgment in the product documentation would be       *
+ * appreciated but is not required.                                            *
+ *                                                                             *
+ * 2. Altered source versions must be plainly marked as such, and must not be  *
+ * misrepresented as being the original software.                              *
+ *                                                                             *
+ * 3. This notice may not be removed or altered from any source                *
+ * distribution.                                                               *
+ ******************************************************************************/
+
+#include "Program.h"
+#include "Bytecode.h"
+#include "Exceptions.h"
+
+#include <cstring>
+#include <limits>
+#include <map>
+
+using namespace std;
+using namespace ionscript;
+
+Program::Program(char* bytecode) : mCallSitesCount(0) {
+   BytecodeReader reader(bytecode);
+
+   unsigned int magicNumber, version;
+   index_t size;
+   reader >> magicNumber >> version >> size;
+
+   if (magicNumber != kMagicNumber)
+      throw RuntimeError("Given bytes do not form a valid bytecode.");
+   if (version > kVersion)
+      throw RuntimeError("Given bytecode has version higher than this Virtual Machine one.");
+   if (version < kVersion)
+      throw RuntimeError("Given bytecode has been compiled by an older Virtual Machine, please recompile it.");
+
+   // Byte offset of each instruction -> its index, needed to translate jump targets.
+   map<index_t, index_t> indices;
+   map<uint64_t, index_t> numbers;
+   map<string, index_t> strings;
+
+   while (reader.continues()) {
+      indices[reader.getCursorPosition()] = mInstructions.size();
+
+      Instruction instruction;
+      instruction.a = instruction.b = instruction.c = 0;
+      reader >> instruction.op;
+
+      location_t loc1, loc2, loc3;
+      small_size_t n1, n2;
+      index_t index;
+
+      switch (instruction.op) {
+         case OP_NOP:
+         case OP_PUSH:
+         case OP_POP:
+         case OP_RETURN_NIL:
+         case OP_HALT:
+            break;
+
+         case OP_REG:
+         case OP_POP_N:
+            reader >> n1;
+            instruction.a = n1;
+            break;
+
+         case OP_STORE_AT_NIL:
+         case OP_RETURN:
+         case OP_LIST_NEW:
+         case OP_DICTIONARY_NEW:
+            reader >> loc1;
+            instruction.a = loc1;
+            break;
+
+         case OP_PUSH_N:
+         {
+            double number;
+            reader >> number;
+            instruction.a = getNumberIndex(number, numbers);
+            break;
+         }
+
+         case OP_INC:
+         case OP_DEC:
+         {
+            double number;
+            reader >> loc1 >> number;
+            instruction.a = loc1;
+            instruction.b = getNumberIndex(number, numbers);
+            break;
+         }
+
+         case OP_ADDI:
+         case OP_SUBI:
+         case OP_MULI:
+         case OP_DIVI:
+         case OP_EQI:
+         case OP_NEQI:
+         case OP_GRI:
+         case OP_GREI:
+         case OP_LSI:
+         case OP_LSEI:
+         {
+            double number;
+            reader >> loc1 >> loc2 >> number;
+            instruction.a = loc1;
+            instruction.b = loc2;
+            instruction.c = getNumberIndex(number, numbers);
+            break;
+         }
+
+         case OP_JEQI:
+         case OP_JNEQI:
+         case OP_JGRI:
+         case OP_JGREI:
+         case OP_JLSI:
+         case OP_JLSEI:
+         {
+            double number;
+            reader >> loc1 >> number >> index;
+            instruction.a = loc1;
+            instruction.b = getNumberIndex(number, numbers);
+            instruction.c = index;
+            break;
+         }
+
+         case OP_PUSH_S:
+         {
+            string str;
+            reader >> str;
+            map<string, index_t>::iterator it = strings.find(str);
+            if (it == strings.end()) {
+               it = strings.insert(make_pair(str, (index_t) mStrings.size())).first;
+               mStrings.push_back(str);
+            }
+            instruction.a = it->second;
+            break;
+         }
+
+         case OP_PUSH_B:
+         {
+            bool boolean;
+            reader >> boolean;
+            instruction.a = boolean;
+            break;
+         }
+
+         case OP_STORE_AT_F:
+            reader >> loc1 >> index >> n1 >> n2;
+            instruction.a = loc1;
+            instruction.b = index;
+            instruction.c = Instruction::packFunctionSizes(n1, n2);
+            break;
+
+         case OP_MOVE:
+         case OP_NOT:
+         case OP_LIST_ADD:
+         case OP_LEN:
+         case OP_FLOOR:
+         case OP_SQRT:
+         case OP_ABS:
+            reader >> loc1 >> loc2;
+            instruction.a = loc1;
+            instruction.b = loc2;
+            break;
+
+         case OP_ADD:
+         case OP_SUB:
+         case OP_MUL:
+         case OP_DIV:
+         case OP_AND:
+         case OP_OR:
+         case OP_EQ:
+         case OP_NEQ:
+         case OP_GR:
+         case OP_GRE:
+         case OP_LS:
+         case OP_LSE:
+         case OP_DICTIONARY_ADD:
+         case OP_GET:
+         case OP_SET:
+         case OP_APPEND:
+         case OP_MIN:
+         case OP_MAX:
+            reader >> loc1 >> loc2 >> loc3;
+            instruction.a = loc1;
+            instruction.b = loc2;
+            instruction.c = loc3;
+            break;
+
+         case OP_SLICE:
+         {
+            location_t loc4;
+            reader >> loc1 >> loc2 >> loc3 >> loc4;
+            instruction.a = loc1;
+            instruction.b = loc2;
+            instruction.c = Instruction::packSliceBounds(loc3, loc4);
+            break;
+         }
+
+         case OP_JUMP:
+            reader >> index;
+            instruction.a = index;
+            break;
+
+         case OP_JUMP_COND:
+            reader >> loc1 >> index;
+            instruction.a = loc1;
+            instruction.b = index;
+            break;
+
+         case OP_JEQ:
+         case OP_JNEQ:
+         case OP_JGR:
+         case OP_JGRE:
+         case OP_JLS:
+         case OP_JLSE:
+            reader >> loc1 >> loc2 >> index;
+            instruction.a = loc1;
+            instruction.b = loc2;
+            instruction.c = index;
+            break;
+
+         case OP_CALL_SF_G:
+         case OP_CALL_SF_L:
+            reader >> loc1 >> loc2 >> n1 >> loc3;
+            instruction.a = (instruction.op == OP_CALL_SF_G) ? Instruction::packGlobalCall(loc1, mCallSitesCount++) : loc1;
+            instruction.b = Instruction::packCallWindow(loc2, n1);
+            instruction.c = loc3;
+            break;
+
+         case OP_CALL_BF:
+            reader >> index >> loc2 >> n1 >> loc3;
+            instruction.a = index;
+            instruction.b = Instruction::packCallWindow(loc2, n1);
+            instruction.c = loc3;
+            break;
+
+         case OP_TAIL_CALL_SF_G:
+         case OP_TAIL_CALL_SF_L:
+            reader >> loc1 >> loc2 >> n1;
+            instruction.a = (instruction.op == OP_TAIL_CALL_SF_G) ? Instruction::packGlobalCall(loc1, mCallSitesCount++) : loc1;
+            instruction.b = Instruction::packCallWindow(loc2, n1);
+            break;
+
+         case OP_CALL_HF:
+         case OP_CALL_HF_S:
+         {
+            FunctionID fID;
+            reader >> index >> fID >> loc2 >> n1 >> loc3;
+            instruction.a = Instruction::packHostFunction(index, fID);
+            instruction.b = Instruction::packCallWindow(loc2, n1);
+            instruction.c = loc3;
+            break;
+         }
+
+         default:
+            throw RuntimeError("Unsupported op-code.");
+      }
+
+      mInstructions.push_back(instruction);
+   }
+
+   if (mInstructions.empty() || mInstructions.back().op != OP_HALT)
+      throw RuntimeError("Given bytecode is truncated.");
+
+   // Translate byte offsets into instruction indices.
+   for (size_t i = 0; i < mInstructions.size(); i++) {
+      int32_t* pTarget;
+      switch (mInstructions[i].op) {
+         case OP_JUMP:
+            pTarget = &mInstructions[i].a;
+            break;
+         case OP_JUMP_COND:
+         case OP_STORE_AT_F:
+            pTarget = &mInstructions[i].b;
+            break;
+         case OP_JEQ:
+         case OP_JNEQ:
+         case OP_JGR:
+         case OP_JGRE:
+         case OP_JLS:
+         case OP_JLSE:
+         case OP_JEQI:
+         case OP_JNEQI:
+         case OP_JGRI:
+         case OP_JGREI:
+         case OP_JLSI:
+         case OP_JLSEI:
+            pTarget = &mInstructions[i].c;
+            break;
+         default:
+            continue;
+      }
+
+      map<index_t, index_t>::const_iterator it = indices.find(*pTarget);
+      if (it == indices.end())
+         throw RuntimeError("Given bytecode contains an invalid jump.");
+      *pTarget = it->second;
+   }
+}
+
+index_t Program::getNumberIndex(double number, map<uint64_t, index_t>& numbers) {
+   uint64_t bits;
+   if (number != number)
+      number = numeric_limits<double>::quiet_NaN();
+   memcpy(&bits, &number, sizeof (double));
+
+   map<uint64_t, index_t>::iterator it = numbers.find(bits);
+   if (it == numbers.end()) {
+      it = numbers.insert(make_pair(bits, (index_t) mNumbers.size())).first;
+      mNumbers.push_back(number);
+   }
+   return it->second;
+}
@@ -0,0 +1,166 @@
+/*******************************************************************************
+ * IonScript                                                                   *
+ * (c) 2010-2011 Canio Massimo Tristano <massimo.tristano@gmail.com>           *
+ *                                                                             *
+ * This software is provided 'as-is', without any express or implied           *
+ * warranty. In no event will the authors be held liable for any damages       *
+ * arising from the use of this software.                                      *
+ *                                                                             *
+ * Permission is granted to anyone to use this software for any purpose,       *
+ * including commercial applications, and to alter it and redistribute it      *
+ * freely, subject to the following restrictions:                              *
+ *                                                                             *
+ * 1. The origin of this software must not be misrepresented; you must not     *
+ * claim that you wrote the original software. If you use this software        *
+ * in a product, an acknowledgment in the product documentation would be       *
+ * appreciated but is not required.                                            *
+ *                                                                             *
+ * 2. Altered source versions must be plainly marked as such, and must not be  *
+ * misrepresented as being the original software.                              *
+ *                                                                             *
+ * 3. This notice may not be removed or altered from any source                *
+ * distribution.                                                               *
+ ******************************************************************************/
+
+#ifndef ION_SCRIPT_PROGRAM_H
+#define	ION_SCRIPT_PROGRAM_H
+
+#include "Typedefs.h"
+#include "OpCode.h"
+#include "Value.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace ionscript {
+
+   /**
+    * A decoded instruction. Every instruction has the same size and stores its operands as native integers so that the
+    * VirtualMachine can execute it without any decoding. Operands meaning depends on the op-code and follows the order
+    * described in OpCode, except that:
+    *    1) jump targets and function entry points are instruction indices rather than byte offsets;
+    *    2) push.n and push.s store the index of their constant in the Program constant pools;
+    *    3) store_at.f packs the arguments count and the registers count into <c> (see packFunctionSizes());
+    *    4) call instructions pack the window and the arguments count into <b> (see packCallWindow()) and store the target in
+    *       <c>, call_hf packs the host function group and the function ID into <a> (see packHostFunction());
+    *    5) call_sf.g and tcall_sf.g pack the function location and their call site index into <a> (see packGlobalCall());
+    *    6) slice packs the locations of both bounds into <c> (see packSliceBounds()).
+    */
+   struct Instruction {
+      OpCode op;
+      int32_t a;
+      int32_t b;
+      int32_t c;
+
+      /**
+       * @return the <c> operand of a store_at.f instruction.
+       */
+      static inline int32_t packFunctionSizes(small_size_t nArguments, small_size_t nRegisters) {
+         return nArguments | (nRegisters << 8);
+      }
+      /**
+       * @return the <b> operand of call instructions. The window is never negative.
+       */
+      static inline int32_t packCallWindow(location_t window, small_size_t nArguments) {
+         return (unsigned char) window | (nArguments << 8);
+      }
+      /**
+       * @return the <a> operand of a call_hf instruction.
+       */
+      static inline int32_t packHostFunction(index_t hostFunctionGroupID, FunctionID functionID) {
+         return functionID | (hostFunctionGroupID << 8);
+      }
+      /**
+       * @return the <a> operand of call_sf.g and tcall_sf.g instructions: the global location of the function and the index of
+       * the inline cache of the call site.
+       */
+      static inline int32_t packGlobalCall(location_t function, index_t callSite) {
+         return (unsigned char) function | (callSite << 8);
+      }
+      /**
+       * @return the <c> operand of a slice instruction. Both locations keep their sign once unpacked as int8_t.
+       */
+      static inline int32_t packSliceBounds(location_t begin, location_t end) {
+         return (unsigned char) begin | ((unsigned char) end << 8);
+      }
+   };
+
+   /**
+    * A program ready to be executed by the VirtualMachine. It is built once from the bytecode generated by the Compiler, which
+    * is decoded into an array of fixed-width Instructions. Number and string constants are moved into constant pools, and
+    * equal strings are interned into the same entry.
+    * A Program is never modified once built: any number of VirtualMachines, on any threads, can run the same one at the same
+    * time (see VirtualMachine::run()). Each of them copies the instructions, which it quickens, and builds string Values of its
+    * own from the string constants. These are plain std::strings rather than Values, so a Program holds nothing allocated by
+    * an Allocator and can be released on any thread.
+    */
+   class Program {
+   public:
+      /**
+       * Decodes given bytecode.
+       * @param bytecode pointer to the first byte of the bytecode.
+       * @throw RuntimeError if the bytecode is not valid or has been compiled for a different version.
+       */
+      Program(char* bytecode);
+      /**
+       * @return a pointer to the first instruction.
+       */
+      inline const Instruction* getInstructions() const {
+         return &mInstructions[0];
+      }
+      /**
+       * @return the number of instructions.
+       */
+      inline size_t getInstructionsCount() const {
+         return mInstructions.size();
+      }
+      /**
+       * @return the number constant at given index.
+       */
+      inline double getNumber(index_t index) const {
+         return mNumbers[index];
+      }
+      /**
+       * @return a pointer to the first number constant.
+       */
+      inline const double* getNumbers() const {
+         return mNumbers.data();
+      }
+      /**
+       * @return the string constant at given index.
+       */
+      inline const std::string& getString(index_t index) const {
+         return mStrings[index];
+      }
+      /**
+       * @return the number of string constants.
+       */
+      inline size_t getStringsCount() const {
+         return mStrings.size();
+      }
+      /**
+       * @return the number of call_sf.g and tcall_sf.g instructions, each one owns an inline cache in the VM.
+       */
+      inline size_t getCallSitesCount() const {
+         return mCallSitesCount;
+      }
+
+   private:
+      std::vector<Instruction> mInstructions;
+      std::vector<double> mNumbers;
+      std::vector<std::string> mStrings;
+      size_t mCallSitesCount;
+
+      /**
+       * @return the index of given number in the number constant pool, adding it if not present yet.
+       * @param numbers map from the bits of the numbers already in the pool to their indices. Numbers are told apart by their bits
+       *    rather than compared, which NaN does not allow and which would merge -0 and 0.
+       */
+      index_t getNumberIndex(double number, std::map<uint64_t, index_t>& numbers);
+   };
+}
+
+#endif	/* ION_SCRIPT_PROGRAM_H */
+
@@ -70,6 +70,7 @@ namespace ionscript {
          TYPE_PAIR,
          TYPE_PRODUCT,
          TYPE_RETURN,
+         TYPE_SLICE,
          TYPE_STRING,
          TYPE_SUM,
          TYPE_UNKNOWN,
@@ -32,21 +32,24 @@
 namespace ionscript {
 
    const static unsigned int kMagicNumber = 193687;
-   const static unsigned int kVersion = 1;
+   const static unsigned int kVersion = 10;
 
    class Value;
+   class Allocator;
+   class Array;
    class VirtualMachine;
    class Compiler;
    class FunctionCallManager;
+   class Fiber;
    class SyntaxTree;
    class Parser;
    class Lexer;
    class BytecodeReader;
    class BytecodeWriter;
-   struct ValueComp;
+   class Program;
+   class Dictionary;
 
    typedef std::vector<Value> List;
-   typedef std::map<Value, Value, ValueComp> Dictionary;
 
    typedef size_t HostFunctionGroupID;
    typedef unsigned char FunctionID;
@@ -56,6 +59,12 @@ namespace ionscript {
       FunctionID fID;
       int minArgumentsCount;
       int maxArgumentsCount;
+      /** Index of the HostBinding of a function bound by VirtualMachine::bind(), -1 for functions of host function groups. */
+      int bindingID;
+      /** Whether the function may suspend the VM, which is then called by call_hf.s. */
+      bool maySuspend;
+      /** OpCode the Compiler emits in place of the call (see VirtualMachine::setIntrinsic()), -1 if the function is always called. */
+      int intrinsic;
    };
    typedef std::map<std::string, FunctionInfo> HostFunctionsMap;
    typedef void (*HostFunction)(const FunctionCallManager&);
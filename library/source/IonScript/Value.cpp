@@ -23,8 +23,12 @@
  ******************************************************************************/
 
 #include "Value.h"
+#include "Array.h"
+#include "Dictionary.h"
+#include "Collector.h"
 #include "Exceptions.h"
 
+#include <algorithm>
 #include <iostream>
 #include <cstring>
 #include <vector>
@@ -34,109 +38,134 @@
 using namespace std;
 using namespace ionscript;
 
-Value::Value() : mType(TYPE_NIL) { }
+const uint64_t Value::kTagMask;
+const uint64_t Value::kPayloadMask;
+const uint64_t Value::kTagNil;
+const uint64_t Value::kTagBoolean;
+const uint64_t Value::kTagFunction;
+const uint64_t Value::kTagString;
+const uint64_t Value::kTagList;
+const uint64_t Value::kTagDictionary;
+const uint64_t Value::kTagObject;
+const uint64_t Value::kCanonicalNaN;
+const size_t Value::kSharedSliceLength;
+const Value::Type Value::kTagTypes[7] = {TYPE_NIL, TYPE_BOOLEAN, TYPE_SCRIPT_FUNCTION, TYPE_STRING, TYPE_LIST, TYPE_DICTIONARY, TYPE_OBJECT};
 
-Value::Value(const Value& original) {
-   mType = TYPE_NIL;
-   *this = original;
+Value::Value(const char* value) : mBits(kTagNil) {
+   setHeader(kTagString, new ValueCell<string > (value));
 }
 
-Value::Value(int value) : mType(TYPE_NUMBER), mNumber(value) { }
-
-Value::Value(double value) : mType(TYPE_NUMBER), mNumber(value) { }
-
-Value::Value(const char* value) : mType(TYPE_STRING), mpReferenceCount(new int(1)), mObjectPointer(new string(value)), mObjectTypeName(typeid (std::string).name()) { }
-
-Value::Value(const std::string& value) : mType(TYPE_STRING), mpReferenceCount(new int(1)), mObjectPointer(new string(value)), mObjectTypeName(typeid (std::string).name()) { }
-
-Value::Value(bool value) : mType(TYPE_BOOLEAN), mBoolean(value) { }
+Value::Value(Array* pArray) : mBits(kTagNil) {
+   setHeader(kTagObject, pArray);
+}
 
-Value::~Value() {
-   cleanup();
+Value::Value(const std::string& value) : mBits(kTagNil) {
+   setHeader(kTagString, new ValueCell<string > (value));
 }
 
-void Value::assertType(int type) const {
-   if (!(mType & type)) {
-      stringstream ss;
+void Value::typeAssertionFailed(int type) const {
+   stringstream ss;
 
-      ss << "value type assertion failed: value type is " << getTypeName(mType) << " while allowed ones are ";
+   ss << "value type assertion failed: value type is " << getTypeName(getType()) << " while allowed ones are ";
 
-      bool following = false;
-      for (int i = 0; i < 7; i++) {
-         int t = (1 << i);
-         if (type & t) {
-            if (following)
-               ss << ", ";
-            ss << getTypeName((Type) t);
-            following = true;
-         }
+   bool following = false;
+   for (int i = 0; i < 7; i++) {
+      int t = (1 << i);
+      if (type & t) {
+         if (following)
+            ss << ", ";
+         ss << getTypeName((Type) t);
+         following = true;
       }
+   }
 
-      ss << ".";
+   ss << ".";
 
-      throw RuntimeError(ss.str());
-   }
+   throw RuntimeError(ss.str());
 }
 
 void Value::setNil() {
    cleanup();
-   mType = TYPE_NIL;
+   mBits = kTagNil;
 }
 
 void Value::setFunctionValue(index_t functionIndex, unsigned char nArguments, unsigned char nRegisters) {
    cleanup();
-   mType = TYPE_SCRIPT_FUNCTION;
-   this->mFunctionIndex = functionIndex;
-   this->mnFunctionRegisters = nRegisters;
-   this->mnArguments = nArguments;
+   mBits = kTagFunction | ((uint64_t) functionIndex << 16) | ((uint64_t) nArguments << 8) | nRegisters;
 }
 
 List& Value::setEmptyList() {
-   List* pTree = new List();
-   setList(pTree);
-   return *pTree;
+   ValueCell<List>* pCell = new ValueCell<List > ();
+   setHeader(kTagList, pCell);
+   return pCell->payload;
 }
 
 void Value::setList(List* pList) {
-   cleanup();
-   mType = TYPE_LIST;
-   mpReferenceCount = new int(1);
-   mObjectPointer = pList;
-   mObjectTypeName = typeid (List).name();
+   ValueCell<List>* pCell = new ValueCell<List > ();
+   pCell->payload.swap(*pList);
+   delete pList;
+   setHeader(kTagList, pCell);
+}
+
+void Value::unshareList() const {
+   ValueCell<List>* pCell = static_cast<ValueCell<List>*> (getHeader());
+   ValueCell<List>* pBacking = static_cast<ValueCell<List>*> (pCell->backing.getHeader());
+   List& elements = pBacking->payload;
+   List::iterator first = elements.begin() + pCell->offset, last = first + pCell->length;
+
+   if (pBacking->mReferenceCount == 1) {
+      elements.erase(last, elements.end());
+      elements.erase(elements.begin(), first);
+      pCell->payload.swap(elements);
+   } else
+      pCell->payload.assign(first, last);
+   pCell->mpObject = &pCell->payload;
+   pCell->mShared = false;
+   pCell->backing.setNil();
+}
+
+size_t Value::getSharedListSize() const {
+   return static_cast<ValueCell<List>*> (getHeader())->length;
+}
+
+const Value* Value::getListElements() const {
+   const List& list = *reinterpret_cast<List*> (getHeader()->mpObject);
+   if (getHeader()->mShared)
+      return list.data() + static_cast<ValueCell<List>*> (getHeader())->offset;
+   return list.data();
 }
 
 Dictionary& Value::setEmptyDictionary() {
-   Dictionary* pDictionary = new Dictionary();
-   setDictionary(pDictionary);
-   return *pDictionary;
+   ValueCell<Dictionary>* pCell = new ValueCell<Dictionary > ();
+   setHeader(kTagDictionary, pCell);
+   return pCell->payload;
 }
 
 void Value::setDictionary(Dictionary* pDictionary) {
-   cleanup();
-   mType = TYPE_DICTIONARY;
-   mpReferenceCount = new int(1);
-   mObjectPointer = pDictionary;
-   mObjectTypeName = typeid (Dictionary).name();
+   ValueCell<Dictionary>* pCell = new ValueCell<Dictionary > ();
+   pCell->payload.swap(*pDictionary);
+   delete pDictionary;
+   setHeader(kTagDictionary, pCell);
 }
 
 Value& Value::getDictionaryElement(const Value& value) const {
-   Dictionary::iterator it = reinterpret_cast<Dictionary*> (mObjectPointer)->find(value);
-   if (it == reinterpret_cast<Dictionary*> (mObjectPointer)->end())
+   Dictionary::iterator it = getDictionary().find(value);
+   if (it == getDictionary().end())
       throw RuntimeError("key error, " + value.toString() + ".");
    else
       return it->second;
 }
 
 bool Value::toBoolean() const {
-   switch (mType) {
+   switch (getType()) {
       case TYPE_NIL:
          return false;
 
       case TYPE_BOOLEAN:
-         return mBoolean;
+         return getBoolean();
 
       case TYPE_NUMBER:
-         return mNumber != 0.0;
+         return getNumber() != 0.0;
 
       case TYPE_STRING:
          return getString() != "";
@@ -145,10 +174,12 @@ bool Value::toBoolean() const {
          return true;
 
       case TYPE_OBJECT:
-         return mObjectPointer != 0;
+         if (isArray())
+            return getArray().getSize() > 0;
+         return getHeader()->mpObject != 0;
 
       case TYPE_LIST:
-         return getList().size() > 0;
+         return getListSize() > 0;
 
       case TYPE_DICTIONARY:
          return getDictionary().size() > 0;
@@ -168,23 +199,30 @@ std::string Value::toString() const {
          ss << getString();
          break;
       case Value::TYPE_SCRIPT_FUNCTION:
-         ss << "<function at " << mFunctionIndex << '>';
+         ss << "<function at " << getFunctionIndex() << '>';
          break;
       case Value::TYPE_BOOLEAN:
          ss << ((getBoolean()) ? "true" : "false");
          break;
       case Value::TYPE_OBJECT:
-         ss << "<" << ((mpReferenceCount != 0) ? "managed " : "") << "object " << mObjectTypeName << " at " << mObjectPointer << ">";
+         if (isArray()) {
+            ss << ((getArray().getElementType() == Array::ELEMENT_FLOAT64) ? "float64[" : "int32[");
+            for (size_t i = 0; i < getArray().getSize(); i++)
+               ss << ((i > 0) ? ", " : "") << getArray().get(i);
+            ss << ']';
+            break;
+         }
+         ss << "<" << (getHeader()->mManaged ? "managed " : "") << "object " << getHeader()->mTypeName << " at " << getHeader()->mpObject << ">";
          break;
 
       case Value::TYPE_LIST:
          ss << '[';
-         for (size_t i = 0; i < getList().size(); i++) {
-            if (getList()[i].isString())
-               ss << '"' << getList()[i].toString() << '"';
+         for (size_t i = 0; i < getListSize(); i++) {
+            if (readListElement(i).isString())
+               ss << '"' << readListElement(i).toString() << '"';
             else
-               ss << getList()[i].toString();
-            if (i != getList().size() - 1)
+               ss << readListElement(i).toString();
+            if (i != getListSize() - 1)
                ss << ", ";
          }
          ss << ']';
@@ -215,82 +253,77 @@ std::string Value::toString() const {
    return ss.str();
 }
 
-Value & Value::operator=(const Value& original) {
-   cleanup();
-   mType = original.mType;
-
-   switch (mType) {
-      case TYPE_NIL:
-         break;
-
-      case TYPE_BOOLEAN:
-         mBoolean = original.mBoolean;
-         break;
-
-
+uint32_t Value::getHash() const {
+   uint64_t bits;
+   switch (getType()) {
       case TYPE_NUMBER:
-         mNumber = original.mNumber;
+         // 0 and -0 are equal so they must hash the same
+         bits = (getNumber() == 0.0) ? 0 : mBits;
          break;
 
-      case TYPE_SCRIPT_FUNCTION:
-         mFunctionIndex = original.mFunctionIndex;
-         mnFunctionRegisters = original.mnFunctionRegisters;
-         mnArguments = original.mnArguments;
-         break;
+      case TYPE_STRING:
+      {
+         ValueCell<string>* pCell = static_cast<ValueCell<string>*> (getHeader());
+         if (!pCell->hashed) {
+            // FNV-1a
+            uint32_t hash = 2166136261u;
+            for (size_t i = 0; i < pCell->payload.size(); i++) {
+               hash ^= (unsigned char) pCell->payload[i];
+               hash *= 16777619u;
+            }
+            pCell->hash = hash;
+            pCell->hashed = true;
+         }
+         return pCell->hash;
+      }
 
       case TYPE_OBJECT:
-      case TYPE_STRING:
+         bits = (uint64_t) (uintptr_t) getHeader()->mpObject;
+         break;
+
       case TYPE_LIST:
+      {
+         uint32_t hash = 1;
+         for (size_t i = 0; i < getListSize(); i++)
+            hash = hash * 31 + readListElement(i).getHash();
+         return hash;
+      }
+
       case TYPE_DICTIONARY:
-         mObjectPointer = original.mObjectPointer;
-         mObjectTypeName = original.mObjectTypeName;
-         mpReferenceCount = original.mpReferenceCount;
-         if (mpReferenceCount)
-            (*mpReferenceCount)++;
-         break;
+      {
+         // order independent, as dictionary equality is
+         uint32_t hash = 0;
+         for (Dictionary::const_iterator it = getDictionary().begin(); it != getDictionary().end(); ++it)
+            hash += it->hash ^ (it->second.getHash() * 31);
+         return hash;
+      }
 
       default:
-         memcpy(&mNumber, &original.mNumber, sizeof (double));
+         // nil, booleans and script functions are stored inline
+         bits = mBits;
          break;
    }
-   return *this;
-}
 
-Value & Value::operator=(int original) {
-   cleanup();
-   mType = TYPE_NUMBER;
-   mNumber = original;
-   return *this;
-}
-
-Value & Value::operator=(double original) {
-   cleanup();
-   mType = TYPE_NUMBER;
-   mNumber = original;
-   return *this;
+   // 64-bit finalizer of MurmurHash3
+   bits ^= bits >> 33;
+   bits *= 0xff51afd7ed558ccdULL;
+   bits ^= bits >> 33;
+   bits *= 0xc4ceb53fe1a85ec9ULL;
+   bits ^= bits >> 33;
+   return (uint32_t) bits;
 }
 
 Value & Value::operator=(const std::string & original) {
-   cleanup();
-   mType = TYPE_STRING;
-   mpReferenceCount = new int(1);
-   mObjectPointer = new string(original);
-   return *this;
-}
-
-Value & Value::operator=(bool original) {
-   cleanup();
-   mType = TYPE_BOOLEAN;
-   mBoolean = original;
+   setHeader(kTagString, new ValueCell<string > (original));
    return *this;
 }
 
 Value Value::operator+(const Value & right) {
 
-   if (right.mType == mType) {
-      switch (mType) {
+   if (right.getType() == getType()) {
+      switch (getType()) {
          case TYPE_NUMBER:
-            return Value(mNumber + right.mNumber);
+            return Value(getNumber() + right.getNumber());
 
          case TYPE_STRING:
             return Value(getString() + right.getString());
@@ -298,10 +331,10 @@ Value Value::operator+(const Value & right) {
          case TYPE_LIST:
          {
             Value v;
-            v.setEmptyList();
-            v.getList().reserve(getList().size() + right.getList().size());
-            v.getList().insert(v.getList().end(), getList().begin(), getList().end());
-            v.getList().insert(v.getList().end(), right.getList().begin(), right.getList().end());
+            List& list = v.setEmptyList();
+            list.reserve(getListSize() + right.getListSize());
+            list.insert(list.end(), getListElements(), getListElements() + getListSize());
+            list.insert(list.end(), right.getListElements(), right.getListElements() + right.getListSize());
             return v;
          }
 
@@ -309,55 +342,116 @@ Value Value::operator+(const Value & right) {
             break;
       }
    }
-   throwOperationError("sum", mType, right.mType);
+   throwOperationError("sum", getType(), right.getType());
    return *this; // it never arrives here
 }
 
+void Value::concatenate(const Value & right) {
+   if (isString() && right.isString() && getHeader()->mReferenceCount == 1) {
+      ValueCell<string>* pCell = static_cast<ValueCell<string>*> (getHeader());
+      pCell->payload += right.getString();
+      pCell->hashed = false;
+      return;
+   }
+   if (isList() && right.isList() && getHeader()->mReferenceCount == 1) {
+      // right may be this very list, whose elements are copied by index as the insertion would invalidate its iterators
+      List& list = getList();
+      size_t size = list.size(), tailSize = right.getListSize();
+      if (list.capacity() < size + tailSize)
+         list.reserve(max(size + tailSize, 2 * list.capacity()));
+      for (size_t i = 0; i < tailSize; i++)
+         list.push_back(right.readListElement(i));
+      return;
+   }
+   *this = *this + right;
+}
+
+Value Value::slice(const Value& begin, const Value& end) const {
+   if (!isArray())
+      assertType(TYPE_LIST | TYPE_STRING);
+   size_t size = isList() ? getListSize() : isString() ? getString().size() : getArray().getSize();
+   size_t from = begin.isNil() ? 0 : begin.getPositiveIntegerSafely();
+   size_t to = end.isNil() ? size : end.getPositiveIntegerSafely();
+
+   if (from > to || to > size)
+      throw RuntimeError("slice out of boundaries.");
+
+   if (isString())
+      return Value(getString().substr(from, to - from));
+   if (isArray())
+      return Value(getArray().slice(from, to));
+
+   Value v;
+   if (to - from < kSharedSliceLength) {
+      v.setEmptyList().assign(getListElements() + from, getListElements() + to);
+      return v;
+   }
+
+   ValueCell<List>* pCell = static_cast<ValueCell<List>*> (getHeader());
+   if (!pCell->mShared) {
+      ValueCell<List>* pBacking = new ValueCell<List > ();
+      pBacking->payload.swap(pCell->payload);
+      pCell->backing.setHeader(kTagList, pBacking);
+      pCell->offset = 0;
+      pCell->length = pBacking->payload.size();
+      pCell->mpObject = &pBacking->payload;
+      pCell->mShared = true;
+   }
+   ValueCell<List>* pSlice = new ValueCell<List > ();
+   v.setHeader(kTagList, pSlice);
+   pSlice->backing = pCell->backing;
+   pSlice->offset = pCell->offset + from;
+   pSlice->length = to - from;
+   pSlice->mpObject = pCell->mpObject;
+   pSlice->mShared = true;
+   return v;
+}
+
 Value Value::operator-(const Value & right) {
-   if (mType == TYPE_NUMBER && right.mType == TYPE_NUMBER)
-      return Value(mNumber - right.mNumber);
+   if (isNumber() && right.isNumber())
+      return Value(getNumber() - right.getNumber());
 
-   throwOperationError("subtract", mType, right.mType);
+   throwOperationError("subtract", getType(), right.getType());
    return *this; // it never arrives here
 }
 
 Value Value::operator*(const Value & right) {
-   if (mType == TYPE_NUMBER && right.mType == TYPE_NUMBER)
-      return Value(mNumber * right.mNumber);
+   if (isNumber() && right.isNumber())
+      return Value(getNumber() * right.getNumber());
 
-   else if (mType == TYPE_STRING && right.mType == TYPE_NUMBER) {
-      if (!right.isInteger() || right.mNumber < 0)
+   else if (isString() && right.isNumber()) {
+      if (!right.isInteger() || right.getNumber() < 0)
          throw RuntimeError("multiplier number must be a positive integer.");
       else {
          string temp = "";
-         for (size_t i = 0; i < (size_t) right.mNumber; ++i)
+         for (size_t i = 0; i < (size_t) right.getNumber(); ++i)
             temp += getString();
          return Value(temp);
       }
 
-   } else if (mType == TYPE_LIST && right.mType == TYPE_NUMBER) {
-      if (!right.isInteger() || right.mNumber < 0)
+   } else if (isList() && right.isNumber()) {
+      if (!right.isInteger() || right.getNumber() < 0)
          throw RuntimeError("multiplier number must be a positive integer.");
       else {
          Value v;
          List& l = v.setEmptyList();
-         l.reserve(getList().size() * right.mNumber);
+         l.reserve(getListSize() * right.getNumber());
 
-         for (size_t i = 0; i < (size_t) right.mNumber; ++i)
-            l.insert(l.end(), getList().begin(), getList().end());
+         for (size_t i = 0; i < (size_t) right.getNumber(); ++i)
+            l.insert(l.end(), getListElements(), getListElements() + getListSize());
 
          return v;
       }
    }
 
-   throwOperationError("multiply", mType, right.mType);
+   throwOperationError("multiply", getType(), right.getType());
    return *this; // it never arrives here
 }
 
 Value Value::operator/(const Value & right) {
-   if (mType == TYPE_NUMBER && right.mType == TYPE_NUMBER)
-      return Value(mNumber / right.mNumber);
-   throwOperationError("divide", mType, right.mType);
+   if (isNumber() && right.isNumber())
+      return Value(getNumber() / right.getNumber());
+   throwOperationError("divide", getType(), right.getType());
    return *this; // it never arrives here
 }
 
@@ -374,21 +468,21 @@ bool Value::operator ||(const Value& right) const {
 }
 
 bool Value::operator==(const Value& right) const {
-   if (mType != right.mType)
+   if (getType() != right.getType())
       return false;
 
-   switch (mType) {
+   switch (getType()) {
       case TYPE_NIL:
          return true;
 
       case TYPE_BOOLEAN:
-         if (mBoolean == right.mBoolean)
+         if (getBoolean() == right.getBoolean())
             return true;
          else
             return false;
 
       case TYPE_NUMBER:
-         if (mNumber == right.mNumber)
+         if (getNumber() == right.getNumber())
             return true;
          else
             return false;
@@ -400,19 +494,19 @@ bool Value::operator==(const Value& right) const {
             return false;
 
       case TYPE_SCRIPT_FUNCTION:
-         if (mFunctionIndex == right.mFunctionIndex)
+         if (getFunctionIndex() == right.getFunctionIndex())
             return true;
          else
             return false;
 
       case TYPE_OBJECT:
-         return mObjectPointer == right.mObjectPointer;
+         return getHeader()->mpObject == right.getHeader()->mpObject;
 
       case TYPE_LIST:
-         if (getList().size() != right.getList().size())
+         if (getListSize() != right.getListSize())
             return false;
-         for (size_t i = 0; i < getList().size(); i++)
-            if (getList()[i] != right.getList()[i])
+         for (size_t i = 0; i < getListSize(); i++)
+            if (readListElement(i) != right.readListElement(i))
                return false;
          return true;
 
@@ -429,64 +523,64 @@ bool Value::operator !=(const Value& right) const {
 }
 
 bool Value::operator<(const Value& right) const {
-   if (mType != right.mType)
-      throwOperationError("compare disequality of", mType, right.mType);
+   if (getType() != right.getType())
+      throwOperationError("compare disequality of", getType(), right.getType());
 
-   switch (mType) {
+   switch (getType()) {
       case TYPE_NUMBER:
-         return mNumber < right.mNumber;
+         return getNumber() < right.getNumber();
       case TYPE_STRING:
          return getString() < right.getString();
       default:
-         throwOperationError("compare disequality of", mType, right.mType);
+         throwOperationError("compare disequality of", getType(), right.getType());
    }
 
    return false;
 }
 
 bool Value::operator>(const Value& right) const {
-   if (mType != right.mType)
-      throwOperationError("compare disequality of", mType, right.mType);
+   if (getType() != right.getType())
+      throwOperationError("compare disequality of", getType(), right.getType());
 
-   switch (mType) {
+   switch (getType()) {
       case TYPE_NUMBER:
-         return mNumber > right.mNumber;
+         return getNumber() > right.getNumber();
       case TYPE_STRING:
          return getString() > right.getString();
       default:
-         throwOperationError("compare disequality of", mType, right.mType);
+         throwOperationError("compare disequality of", getType(), right.getType());
    }
 
    return false;
 }
 
 bool Value::operator<=(const Value& right) const {
-   if (mType != right.mType)
-      throwOperationError("compare disequality of", mType, right.mType);
+   if (getType() != right.getType())
+      throwOperationError("compare disequality of", getType(), right.getType());
 
-   switch (mType) {
+   switch (getType()) {
       case TYPE_NUMBER:
-         return mNumber <= right.mNumber;
+         return getNumber() <= right.getNumber();
       case TYPE_STRING:
          return getString() <= right.getString();
       default:
-         throwOperationError("compare disequality of", mType, right.mType);
+         throwOperationError("compare disequality of", getType(), right.getType());
    }
 
    return false;
 }
 
 bool Value::operator>=(const Value& right) const {
-   if (mType != right.mType)
-      throwOperationError("compare disequality of", mType, right.mType);
+   if (getType() != right.getType())
+      throwOperationError("compare disequality of", getType(), right.getType());
 
-   switch (mType) {
+   switch (getType()) {
       case TYPE_NUMBER:
-         return mNumber >= right.mNumber;
+         return getNumber() >= right.getNumber();
       case TYPE_STRING:
          return getString() >= right.getString();
       default:
-         throwOperationError("compare disequality of", mType, right.mType);
+         throwOperationError("compare disequality of", getType(), right.getType());
    }
 
    return false;
@@ -518,31 +612,39 @@ const std::string& Value::getTypeName(Value::Type type) {
 
 //
 
-void Value::cleanup() {
-   if (mType == TYPE_STRING || mType == TYPE_LIST || mType == TYPE_DICTIONARY || (mType == TYPE_OBJECT && mpReferenceCount != 0)) {
-      --(*mpReferenceCount);
-      if (*mpReferenceCount <= 0) {
-         delete mpReferenceCount;
-         switch (mType) {
-            case TYPE_STRING:
-               delete reinterpret_cast<std::string*> (mObjectPointer);
-               return;
-            case TYPE_OBJECT:
-               delete reinterpret_cast<IManageableObject*> (mObjectPointer);
-               return;
-            case TYPE_LIST:
-               delete reinterpret_cast<List*> (mObjectPointer);
-               return;
-            case TYPE_DICTIONARY:
-               delete reinterpret_cast<Dictionary*> (mObjectPointer);
-               return;
-            default:
-               return;
-         }
-      }
+void Value::setObject(IManageableObject* pManageable, void* pObject, const char* typeName, bool managed) {
+   if (!managed) {
+      setObject((const void*) 0, pObject, typeName, false);
+      return;
    }
+   if (pManageable->mReferenceCount == 0) {
+      pManageable->mTypeName = typeName;
+      pManageable->mpObject = pObject;
+   }
+   setHeader(kTagObject, pManageable);
+}
+
+namespace {
+
+   /**
+    * Header of an object whose memory is not managed by the scripting system.
+    */
+   class UnmanagedObjectHeader : public ValueHeader, public Allocated {
+   public:
+      UnmanagedObjectHeader(void* pObject, const char* typeName) : ValueHeader(pObject, typeName, false) { }
+   };
+}
+
+void Value::setObject(const void*, void* pObject, const char* typeName, bool) {
+   setHeader(kTagObject, new UnmanagedObjectHeader(pObject, typeName));
+}
+
+void Value::destroy() {
+   // the virtual destructor frees the payload allocated with the header, or the managed object the header belongs to
+   delete getHeader();
+   mBits = kTagNil;
 }
 
-void Value::throwOperationError(const std::string& operation, Type firstValueType, Type secondValueType) const throw (RuntimeError) {
+void Value::throwOperationError(const std::string& operation, Type firstValueType, Type secondValueType) const {
    throw RuntimeError("cannot " + operation + " a " + getTypeName(firstValueType) + " with a " + getTypeName(secondValueType) + ".");
 }
@@ -25,6 +25,7 @@
 #ifndef ION_SCRIPT_VALUE_H
 #define	ION_SCRIPT_VALUE_H
 
+#include "Allocator.h"
 #include "Exceptions.h"
 #include "Typedefs.h"
 #include "OpCode.h"
@@ -34,14 +35,79 @@
 #include <typeinfo>
 #include <cstring>
 #include <vector>
+#include <stdint.h>
 
 namespace ionscript {
 
    /**
-    * All managed objects must implement this very trivial interface since C++ does not to delete from void pointers.
+    * Header of every object a Value can point to (strings, lists, dictionaries and objects). It is shared by all the Values referring
+    * to the same content and counts them. Strings, lists and dictionaries are allocated together with their header (see ValueCell),
+    * managed objects carry it as their IManageableObject base so that no heap value needs more than one allocation.
     */
-   class IManageableObject {
+   class ValueHeader {
+      friend class Value;
+      friend class Collector;
+
+   public:
+      virtual ~ValueHeader() { }
+
+   protected:
+      ValueHeader(void* pObject, const char* typeName, bool managed)
+      : mReferenceCount(0), mManaged(managed), mShared(false), mTypeName(typeName), mpObject(pObject) { }
+
+   private:
+      /** Number of Values referring to this header. */
+      int mReferenceCount;
+      /** Whether the pointed object is deleted with the last reference. Always true except for unmanaged objects. */
+      bool mManaged;
+      /** Whether the pointed list shares its elements with its slices, which getList() copies first (see Value::slice()). */
+      bool mShared;
+      /** Name of the C++ type of the pointed object. */
+      const char* mTypeName;
+      /** The pointed object. */
+      void* mpObject;
+
+      ValueHeader(const ValueHeader&);
+      ValueHeader & operator=(const ValueHeader&);
+   };
+
+   /**
+    * A ValueHeader and its payload in a single allocation, made by the current Allocator of the thread. Lists and dictionaries have their own cells, tracked by the Collector
+    * (see Collector.h).
+    */
+   template <typename T>
+   class ValueCell : public ValueHeader, public Allocated {
+   public:
+      ValueCell() : ValueHeader(&payload, typeid (T).name(), true) { }
+
+      template <typename A>
+      explicit ValueCell(const A& argument) : ValueHeader(&payload, typeid (T).name(), true), payload(argument) { }
+
+      T payload;
+   };
+
+   /**
+    * Strings are immutable once shared, so their cell also caches their hash. Only a string referenced by a single Value is
+    * modified, when appended to (see Value::concatenate()), which forgets the hash.
+    */
+   template <>
+   class ValueCell<std::string> : public ValueHeader, public Allocated {
    public:
+      template <typename A>
+      explicit ValueCell(const A& argument) : ValueHeader(&payload, typeid (std::string).name(), true), payload(argument), hashed(false) { }
+
+      std::string payload;
+      uint32_t hash;
+      bool hashed;
+   };
+
+   /**
+    * All managed objects must implement this very trivial interface since C++ does not to delete from void pointers. It also holds
+    * the reference count of the object.
+    */
+   class IManageableObject : public ValueHeader {
+   public:
+      IManageableObject() : ValueHeader(0, 0, true) { }
       virtual ~IManageableObject() { }
    };
 
@@ -70,6 +136,9 @@ namespace ionscript {
     */
    class Value {
       friend class VirtualMachine;
+      friend class ValueStack;
+      friend class Collector;
+      friend class Array;
 
    public:
 
@@ -90,12 +159,22 @@ namespace ionscript {
       /**
        * Constructs an empty value initially set to nil.
        */
-      Value();
+      inline Value() : mBits(kTagNil) { }
       /**
        * Copies the original value into this one.
        * @param original the original value.
        */
-      Value(const Value & original);
+      inline Value(const Value & original) : mBits(original.mBits) {
+         if (isHeapValue())
+            ++getHeader()->mReferenceCount;
+      }
+      /**
+       * Moves the original value into this one, leaving the original nil. No reference count is touched.
+       * @param original the original value.
+       */
+      inline Value(Value && original) noexcept : mBits(original.mBits) {
+         original.mBits = kTagNil;
+      }
       /**
        * Creates a new Value from a const char* string.
        */
@@ -107,15 +186,15 @@ namespace ionscript {
       /**
        * Creates a new Value from an integer.
        */
-      explicit Value(int value);
+      inline explicit Value(int value) : mBits(encodeNumber(value)) { }
       /**
        * Creates a new Value from a double.
        */
-      explicit Value(double value);
+      inline explicit Value(double value) : mBits(encodeNumber(value)) { }
       /**
        * Creates a new Value from a boolean.
        */
-      explicit Value(bool value);
+      inline explicit Value(bool value) : mBits(kTagBoolean | (value ? 1 : 0)) { }
       /**
        * Creates a new Value of type TYPE_OBJECT that embeds a user defined object.
        * @param pObject a pointer to the object.
@@ -123,92 +202,100 @@ namespace ionscript {
        *    the deletion manually or you simply don't want the script engine to delete the object as it is owned by some other user object.
        */
       template <typename T>
-      explicit Value(T* pObject, bool managed = false) {
-         mType = TYPE_OBJECT;
-         if (managed)
-            mpReferenceCount = new int(1);
-         else
-            mpReferenceCount = 0;
-
-         mObjectPointer = (void*) pObject;
-         mObjectTypeName = typeid (T).name();
+      explicit Value(T* pObject, bool managed = false) : mBits(kTagNil) {
+         setObject(pObject, (void*) pObject, typeid (T).name(), managed);
       }
+      /**
+       * Creates a new Value referring to a typed array, whose memory is then managed by the scripting system (see Array).
+       */
+      explicit Value(Array* pArray);
       /**
        * Deconstructor.
        */
-      ~Value();
+      inline ~Value() {
+         cleanup();
+      }
       /**
        * @return true if this Value is nil (TYPE_NIL).
        */
       inline bool isNil() const {
-         return mType == TYPE_NIL;
+         return mBits == kTagNil;
       }
       /**
        * @return true if this Value is a boolean (TYPE_BOOLEAN).
        */
       inline bool isBoolean() const {
-         return mType == TYPE_BOOLEAN;
+         return (mBits & kTagMask) == kTagBoolean;
       }
       /**
        * @return true if this Value is a number (TYPE_NUMBER).
        */
       inline bool isNumber() const {
-         return mType == TYPE_NUMBER;
+         return mBits < kTagNil;
       }
       /**
        * @return true if this Value is a string (TYPE_STRING).
        */
       inline bool isString() const {
-         return mType == TYPE_STRING;
+         return (mBits & kTagMask) == kTagString;
       }
       /**
        * @return true if this Value is a script function (TYPE_SCRIPT_FUNCTION).
        */
       inline bool isScriptFunction() const {
-         return mType == TYPE_SCRIPT_FUNCTION;
+         return (mBits & kTagMask) == kTagFunction;
       }
       /**
        * @return true if this Value is an user object (TYPE_OBJECT).
        */
       inline bool isObject() const {
-         return mType == TYPE_OBJECT;
+         return (mBits & kTagMask) == kTagObject;
       }
       /**
        * @return true if this Value is a user object (TYPE_OBJECT) and it is managed.
        */
       inline bool isManagedObject() const {
-         return mType == TYPE_OBJECT && mpReferenceCount != 0;
+         return isObject() && getHeader()->mManaged;
       }
       /**
        * @return true if this Value is an integer number.
        */
       inline bool isInteger() const {
-         return mType == TYPE_NUMBER && ((int) mNumber) == mNumber;
+         return isNumber() && ((int) getNumber()) == getNumber();
       }
       /**
        * @return true if this Value is a positive integer number.
        */
       inline bool isPositiveInteger() const {
-         return isInteger() && mNumber >= 0;
+         return isInteger() && getNumber() >= 0;
       }
       /**
        * @return true if this Value is a list (TYPE_LIST).
        */
       inline bool isList() const {
-         return mType == TYPE_LIST;
+         return (mBits & kTagMask) == kTagList;
+      }
+      /**
+       * @return true if this Value is a typed array, an object (TYPE_OBJECT) that the VirtualMachine handles natively.
+       */
+      inline bool isArray() const {
+         return isObject() && getHeader()->mTypeName == kArrayTypeName;
       }
       /**
        * @return true if this Value is dictionary (TYPE_LIST).
        */
       inline bool isDictonary() const {
-         return mType == TYPE_DICTIONARY;
+         return (mBits & kTagMask) == kTagDictionary;
       }
       /**
        * Asserts this Value has type as specified. It returns silently if assertion succeeds.
        * @param type desired type. You can combine different accepted types with the | operator.
        * @throw RuntimeError if assertion fails.
        */
-      void assertType(int type) const;
+      inline void assertType(int type) const {
+         if (!(getType() & type))
+            typeAssertionFailed(type);
+      }
       /**
        * Asserts this Value is an integer. It returns silently if assertion succeeds.
        * @throw RuntimeError if assertion fails.
@@ -229,28 +316,32 @@ namespace ionscript {
        * @return this value type.
        */
       inline Type getType() const {
-         return mType;
+         if (isNumber())
+            return TYPE_NUMBER;
+         return kTagTypes[(mBits >> 48) - (kTagNil >> 48)];
       }
       /**
        * @return the contained boolean value.
        * @remark it does not check type for efficiency. Behaviour is unknown and definitely incorrect if this Value is not a TYPE_BOOLEAN.
        */
       inline bool getBoolean() const {
-         return mBoolean;
+         return (mBits & 1) != 0;
       }
       /**
        * @return the contained number value.
        * @remark it does not check type for efficiency. Behaviour is unknown and definitely incorrect if this Value is not a TYPE_NUMBER.
        */
       inline double getNumber() const {
-         return mNumber;
+         double number;
+         memcpy(&number, &mBits, sizeof (double));
+         return number;
       }
       /**
        * @return the contained string value.
        * @remark it does not check type for efficiency. Behaviour is unknown and definitely incorrect if this Value is not a TYPE_STRING.
        */
       inline const std::string & getString() const {
-         return *reinterpret_cast<std::string*> (mObjectPointer);
+         return *reinterpret_cast<std::string*> (getHeader()->mpObject);
       }
       /**
        * @return the contained object pointer value if the requested type is correct, 0 otherwise.
@@ -258,14 +349,14 @@ namespace ionscript {
        */
       template<typename T >
       T * getObject() const {
-         return reinterpret_cast<T*> (mObjectPointer);
+         return reinterpret_cast<T*> (getHeader()->mpObject);
       }
       /**
        * @return the object type name string.
        * @remarks it does not check type for efficiency. Behaviour is unknown and definitely incorrect if this Value is not a TYPE_OBJECT.
        */
       std::string getObjectTypeName() const {
-         return std::string(mObjectTypeName);
+         return std::string(getHeader()->mTypeName);
       }
       /**
        * Checks that the user object type corresponds to the one specified.
@@ -274,14 +365,17 @@ namespace ionscript {
        * @remark it does not check type for efficiency. Behaviour is unknown and definitely incorrect if this Value is not a TYPE_OBJECT.
        */
       inline bool checkObjectType(const std::type_info & type) const {
-         return strcmp(mObjectTypeName, type.name()) == 0;
+         return strcmp(getHeader()->mTypeName, type.name()) == 0;
       }
       /**
-       * @return the contained list value.
+       * @return the contained list value. A list sharing its elements with its slices gets a copy of its own first (see slice()):
+       *    getListSize() and readListElement() read it without copying.
        * @remark it does not check type for efficiency. Behaviour is unknown and definitely incorrect if this Value is not a TYPE_LIST.
        */
       inline List & getList() const {
-         return *reinterpret_cast<List*> (mObjectPointer);
+         if (getHeader()->mShared)
+            unshareList();
+         return *reinterpret_cast<List*> (getHeader()->mpObject);
       }
       /**
        * @return the contained list value element at specified index.
@@ -289,14 +383,42 @@ namespace ionscript {
        * @remark it does not check type for efficiency. Behaviour is unknown and definitely incorrect if this Value is not a TYPE_LIST.
        */
       inline Value & getListElement(size_t index) const {
-         return reinterpret_cast<List*> (mObjectPointer)->at(index);
+         return getList().at(index);
+      }
+      /**
+       * @return the number of elements of the contained list. Unlike getList(), it never copies the elements of a slice.
+       * @remark it does not check type for efficiency. Behaviour is unknown and definitely incorrect if this Value is not a TYPE_LIST.
+       */
+      inline size_t getListSize() const {
+         if (getHeader()->mShared)
+            return getSharedListSize();
+         return reinterpret_cast<List*> (getHeader()->mpObject)->size();
+      }
+      /**
+       * @return the contained list element at specified index, to be read only. Unlike getListElement(), it never copies the
+       *    elements of a slice.
+       * @param index index of the element.
+       * @remark it checks neither the type nor the index for efficiency. Behaviour is unknown and definitely incorrect if this Value
+       *    is not a TYPE_LIST or if index is not lower than getListSize().
+       */
+      inline const Value & readListElement(size_t index) const {
+         if (getHeader()->mShared)
+            return getListElements()[index];
+         return (*reinterpret_cast<List*> (getHeader()->mpObject))[index];
+      }
+      /**
+       * @return the contained typed array.
+       * @remark it does not check type for efficiency. Behaviour is unknown and definitely incorrect if this Value is not an array.
+       */
+      inline Array & getArray() const {
+         return *reinterpret_cast<Array*> (getHeader()->mpObject);
       }
       /**
        * @return the contained dictionary value.
        * @remark it does not check type for efficiency. Behaviour is unknown and definitely incorrect if this Value is not a TYPE_DICTIONARY.
        */
       inline Dictionary & getDictionary() const {
-         return *reinterpret_cast<Dictionary*> (mObjectPointer);
+         return *reinterpret_cast<Dictionary*> (getHeader()->mpObject);
       }
       /**
        * @return the contained dictionary value element at specified key.
@@ -310,7 +432,7 @@ namespace ionscript {
        */
       inline bool getBooleanSafely() const {
          assertType(TYPE_BOOLEAN);
-         return mBoolean;
+         return getBoolean();
       }
       /**
        * @return the contained number value.
@@ -318,7 +440,7 @@ namespace ionscript {
        */
       inline double getNumberSafely() const {
          assertType(TYPE_NUMBER);
-         return mNumber;
+         return getNumber();
       }
       /**
        * @return the contained integer number value.
@@ -326,7 +448,7 @@ namespace ionscript {
        */
       inline int getIntegerSafely() const {
          assertIsInteger();
-         return mNumber;
+         return getNumber();
       }
       /**
        * @return the contained positive integer number value.
@@ -334,7 +456,7 @@ namespace ionscript {
        */
       inline unsigned int getPositiveIntegerSafely() const {
          assertIsPositiveInteger();
-         return mNumber;
+         return getNumber();
       }
       /**
        * @return the contained string value.
@@ -342,7 +464,7 @@ namespace ionscript {
        */
       inline const std::string & getStringSafely() const {
          assertType(TYPE_STRING);
-         return *reinterpret_cast<std::string*> (mObjectPointer);
+         return *reinterpret_cast<std::string*> (getHeader()->mpObject);
       }
       /**
        * @return the contained object pointer value if the requested type is correct.
@@ -352,10 +474,10 @@ namespace ionscript {
       T * getObjectSafely() const {
          assertType(TYPE_OBJECT);
          if (checkObjectType(typeid (T)))
-            return reinterpret_cast<T*> (mObjectPointer);
+            return reinterpret_cast<T*> (getHeader()->mpObject);
          else
             throw RuntimeError("object type mismatch. Requested is " + std::string(typeid (T).name()) +
-                 " while object type is " + std::string(mObjectTypeName) + ".");
+                 " while object type is " + getObjectTypeName() + ".");
       }
       /**
        * @return the contained managed object pointer value if the requested type is correct.
@@ -365,10 +487,10 @@ namespace ionscript {
       T * getManagedObjectSafely() const {
          assertType(TYPE_OBJECT);
          if (checkObjectType(typeid (Managed<T>)))
-            return reinterpret_cast<Managed<T>*> (mObjectPointer)->getObject();
+            return reinterpret_cast<Managed<T>*> (getHeader()->mpObject)->getObject();
          else
             throw RuntimeError("object type mismatch. Requested is " + std::string(typeid (Managed<T>).name()) +
-                 " while object type is " + std::string(mObjectTypeName) + ".");
+                 " while object type is " + getObjectTypeName() + ".");
       }
       /**
        * @return the contained list value.
@@ -376,7 +498,7 @@ namespace ionscript {
        */
       inline List & getListSafely() const {
          assertType(TYPE_LIST);
-         return *reinterpret_cast<List*> (mObjectPointer);
+         return getList();
       }
       /**
        * @return the contained list value element at specified index.
@@ -385,7 +507,16 @@ namespace ionscript {
        */
       inline Value & getListElementSafely(size_t index) const {
          assertType(TYPE_LIST);
-         return reinterpret_cast<List*> (mObjectPointer)->at(index);
+         return getList().at(index);
+      }
+      /**
+       * @return the contained typed array.
+       * @remark it checks the type and if it's incorrect it throws an exception.
+       */
+      inline Array & getArraySafely() const {
+         if (!isArray())
+            throw RuntimeError("value type assertion failed: expected typed array.");
+         return getArray();
       }
       /**
        * @return the contained dictionary value.
@@ -393,13 +524,27 @@ namespace ionscript {
        */
       inline Dictionary & getDictionarySafely() const {
          assertType(TYPE_DICTIONARY);
-         return *reinterpret_cast<Dictionary*> (mObjectPointer);
+         return *reinterpret_cast<Dictionary*> (getHeader()->mpObject);
       }
 
       /**
        * Sets this value as nil.
        */
       void setNil();
+      /**
+       * Sets this value to a number, releasing the previous content first. Only heap values need any work to be released.
+       */
+      inline void setNumber(double number) {
+         cleanup();
+         mBits = encodeNumber(number);
+      }
+      /**
+       * Sets this value to a boolean, releasing the previous content first. Only heap values need any work to be released.
+       */
+      inline void setBoolean(bool boolean) {
+         cleanup();
+         mBits = kTagBoolean | (boolean ? 1 : 0);
+      }
       /**
        * Sets this value to a script-function.
        * @param functionIndex first function instruction index.
@@ -447,14 +592,61 @@ namespace ionscript {
        * @return a string representation of this value.
        */
       std::string toString() const;
+      /**
+       * @return a hash of this value consistent with operator==, used by Dictionary. Numbers, booleans and strings are hashed
+       *    natively and string hashes are computed only once.
+       */
+      uint32_t getHash() const;
 
-      Value & operator=(const Value & original);
-      Value & operator=(int original);
-      Value & operator=(double original);
+      inline Value & operator=(const Value & original) {
+         // original may live inside the container this Value releases, as in "t = t[0]"
+         uint64_t bits = original.mBits;
+         if (original.isHeapValue())
+            ++original.getHeader()->mReferenceCount;
+         cleanup();
+         mBits = bits;
+         return *this;
+      }
+      /**
+       * Moves the original value into this one, leaving the original nil.
+       */
+      inline Value & operator=(Value && original) noexcept {
+         uint64_t bits = original.mBits;
+         original.mBits = kTagNil;
+         cleanup();
+         mBits = bits;
+         return *this;
+      }
+      inline Value & operator=(int original) {
+         setNumber(original);
+         return *this;
+      }
+      inline Value & operator=(double original) {
+         setNumber(original);
+         return *this;
+      }
       Value & operator=(const std::string & original);
-      Value & operator=(bool original);
+      inline Value & operator=(bool original) {
+         setBoolean(original);
+         return *this;
+      }
 
       Value operator+(const Value & original);
+      /**
+       * Sets this value to the sum of itself and given value. A string or a list referenced by this Value only is appended to
+       * in place, its capacity growing geometrically, so that building it by repeated concatenation takes linear time.
+       */
+      void concatenate(const Value & right);
+      /**
+       * @return a new list, string or typed array with the elements of this one from index begin up to index end excluded.
+       * A nil bound stands for the beginning or the end of this value.
+       * A slice of at least kSharedSliceLength elements of a list is made in constant time: the list moves its elements into a
+       * backing list that it shares with its slices, each one seeing a range of it. The first of them to be modified through
+       * getList() copies its range and stops sharing, so that a slice behaves as a copy. The backing list stays alive as long as
+       * any of them shares it.
+       * @remark it checks types and bounds and throws a RuntimeError if they are incorrect.
+       */
+      Value slice(const Value& begin, const Value& end) const;
       Value operator-(const Value & original);
       Value operator*(const Value & original);
       Value operator/(const Value & original);
@@ -477,41 +669,123 @@ namespace ionscript {
       static const std::string & getTypeName(Type type);
 
    private:
-      Type mType;
-
-      union {
-         bool mBoolean;
-         double mNumber;
-
-         struct {
-            int* mpReferenceCount;
-            void* mObjectPointer;
-            const char* mObjectTypeName;
-         };
+      /**
+       * The NaN-boxed content of this value. Numbers are stored as they are, every other type is encoded in the payload of a quiet
+       * NaN whose upper 16 bits (the tag) identify the type. Booleans and script functions are stored inline while the lower 48 bits
+       * of heap types point to their ValueHeader.
+       */
+      uint64_t mBits;
 
-         struct {
-            unsigned char mnFunctionRegisters;
-            unsigned char mnArguments;
-            index_t mFunctionIndex;
-         };
-
-      };
+      static const uint64_t kTagMask = 0xFFFF000000000000ULL;
+      static const uint64_t kPayloadMask = 0x0000FFFFFFFFFFFFULL;
+      static const uint64_t kTagNil = 0xFFF9000000000000ULL;
+      static const uint64_t kTagBoolean = 0xFFFA000000000000ULL;
+      static const uint64_t kTagFunction = 0xFFFB000000000000ULL;
+      static const uint64_t kTagString = 0xFFFC000000000000ULL;
+      static const uint64_t kTagList = 0xFFFD000000000000ULL;
+      static const uint64_t kTagDictionary = 0xFFFE000000000000ULL;
+      static const uint64_t kTagObject = 0xFFFF000000000000ULL;
+      /** Every NaN number is stored as this one so that it cannot be mistaken for a tag. */
+      static const uint64_t kCanonicalNaN = 0x7FF8000000000000ULL;
+      /** Bits that no value has, NaNs being canonical. They mark caches that hold no value yet. */
+      static const uint64_t kNoValueBits = 0xFFF8000000000000ULL;
+      /** Value type of each tag starting from kTagNil. */
+      static const Type kTagTypes[7];
+      /** Minimum number of elements of the slices that share the elements of their list rather than copying them. */
+      static const size_t kSharedSliceLength = 16;
+      /** Type name of the headers of typed arrays, which tells them apart from the other objects. */
+      static const char kArrayTypeName[];
 
+      /**
+       * Throws the RuntimeError of a failed assertType(), out of line so that the assertion itself is inlined.
+       */
+      void typeAssertionFailed(int type) const;
+      /**
+       * Gives a list sharing its elements with its slices a copy of its own range of them. The last one sharing them takes them
+       * without copying.
+       */
+      void unshareList() const;
+      /**
+       * @return the number of elements of a list sharing them with its slices.
+       */
+      size_t getSharedListSize() const;
+      /**
+       * @return a pointer to the first of the getListSize() elements of a list, shared with its slices or not.
+       */
+      const Value* getListElements() const;
+      /**
+       * @return the bits representing given number.
+       */
+      static inline uint64_t encodeNumber(double number) {
+         uint64_t bits;
+         if (number != number)
+            return kCanonicalNaN;
+         memcpy(&bits, &number, sizeof (double));
+         return bits;
+      }
+      /**
+       * @return true if this value content lives on the heap.
+       */
+      inline bool isHeapValue() const {
+         return mBits >= kTagString;
+      }
+      /**
+       * @return the header of a heap value.
+       */
+      inline ValueHeader* getHeader() const {
+         return reinterpret_cast<ValueHeader*> ((uintptr_t) (mBits & kPayloadMask));
+      }
+      /**
+       * @return the first instruction index of a script function.
+       */
+      inline index_t getFunctionIndex() const {
+         return (index_t) ((mBits >> 16) & 0xFFFFFFFF);
+      }
+      /**
+       * @return the number of arguments of a script function.
+       */
+      inline small_size_t getFunctionArgumentsCount() const {
+         return (small_size_t) ((mBits >> 8) & 0xFF);
+      }
+      /**
+       * @return the number of registers of a script function.
+       */
+      inline small_size_t getFunctionRegistersCount() const {
+         return (small_size_t) (mBits & 0xFF);
+      }
+      /**
+       * Makes this value refer to given header with given tag, releasing the previous content.
+       */
+      inline void setHeader(uint64_t tag, ValueHeader* pHeader) {
+         ++pHeader->mReferenceCount;
+         cleanup();
+         mBits = tag | ((uint64_t) (uintptr_t) pHeader & kPayloadMask);
+      }
+      /**
+       * Sets this value to a managed object, which is counted by its own IManageableObject header.
+       */
+      void setObject(IManageableObject* pManageable, void* pObject, const char* typeName, bool managed);
+      /**
+       * Sets this value to an object that does not implement IManageableObject. A separate header is allocated for it.
+       */
+      void setObject(const void*, void* pObject, const char* typeName, bool managed);
       /**
        * Manages memory and deletes the pointed object if necessary.
        */
-      void cleanup();
+      inline void cleanup() {
+         if (isHeapValue() && --getHeader()->mReferenceCount <= 0)
+            destroy();
+      }
+      /**
+       * Deletes the header of a heap value that is not referenced anymore, together with the object if managed.
+       */
+      void destroy();
       /**
        * Operation is not valid.
        */
-      void throwOperationError(const std::string& operation, Type firstValueType, Type secondValueType) const throw ( RuntimeError);
+      void throwOperationError(const std::string& operation, Type firstValueType, Type secondValueType) const;
    };
 
-   struct ValueComp {
-      bool operator() (const Value& lhs, const Value & rhs) const {
-         return lhs.toString() < rhs.toString();
-      }
-   };
 }
 
 #endif	/* ION_SCRIPT_VALUE_H */
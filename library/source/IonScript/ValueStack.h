@@ -0,0 +1,201 @@
+/*******************************************************************************
+ * IonScript                                                                   *
+ * (c) 2010-2011 Canio Massimo Tristano <massimo.tristano@gmail.com>           *
+ *                                                                             *
+ * This software is provided 'as-is', without any express or implied           *
+ * warranty. In no event will the authors be held liable for any damages       *
+ * arising from the use of this software.                                      *
+ *                                                                             *
+ * Permission is granted to anyone to use this software for any purpose,       *
+ * including commercial applications, and to alter it and redistribute it      *
+ * freely, subject to the following restrictions:                              *
+ *                                                                             *
+ * 1. The origin of this software must not be misrepresented; you must not     *
+ * claim that you wrote the original software. If you use this software        *
+ * in a product, an acknowledgment in the product documentation would be       *
+ * appreciated but is not required.                                            *
+ *                                                                             *
+ * 2. Altered source versions must be plainly marked as such, and must not be  *
+ * misrepresented as being the original software.                              *
+ *                                                                             *
+ * 3. This notice may not be removed or altered from any source                *
+ * distribution.                                                               *
+ ******************************************************************************/
+
+#ifndef ION_SCRIPT_VALUE_STACK_H
+#define	ION_SCRIPT_VALUE_STACK_H
+
+#include "Typedefs.h"
+#include "Value.h"
+
+#include <utility>
+
+namespace ionscript {
+
+   /**
+    * The stack of values of the virtual machine. Its capacity is fixed when it is constructed, so references to its values are
+    * never invalidated by pushes, and exceeding it raises a RuntimeError ("stack overflow") instead of reallocating.
+    * Slots above the top never hold heap values, since popping releases them, but they may keep the bits of numbers and
+    * other immediate values, and the arguments of calls being prepared are written right above the top. pushNils() writes nil
+    * over the slots it pushes, so new variables and registers never see stale content.
+    */
+   class ValueStack {
+   public:
+      /**
+       * Number of slots allocated past the capacity. Call arguments are written above the top before the call checks for
+       * overflow, at most a window location plus the arguments count plus the registers count away.
+       */
+      static const size_t kHeadroom = 1024;
+
+      /**
+       * Constructs a stack able to hold up to capacity values.
+       */
+      explicit ValueStack(size_t capacity);
+      ~ValueStack();
+      /**
+       * @return the maximum number of values the stack can hold.
+       */
+      inline size_t getCapacity() const {
+         return mCapacity;
+      }
+      /**
+       * @return the number of values in the stack.
+       */
+      inline size_t size() const {
+         return mSize;
+      }
+      /**
+       * @return a pointer to the bottom of the stack.
+       */
+      inline Value* data() {
+         return mpValues;
+      }
+      inline Value& operator[](size_t index) {
+         return mpValues[index];
+      }
+      /**
+       * @return the value on top of the stack.
+       */
+      inline Value& back() {
+         return mpValues[mSize - 1];
+      }
+      /**
+       * Pushes a copy of given value.
+       * @throw RuntimeError if the stack is full.
+       */
+      inline void push(const Value& value) {
+         if (mSize == mCapacity)
+            overflow();
+         mpValues[mSize++] = value;
+      }
+      /**
+       * Pushes given value moving its content.
+       * @throw RuntimeError if the stack is full.
+       */
+      inline void push(Value&& value) {
+         if (mSize == mCapacity)
+            overflow();
+         mpValues[mSize++] = std::move(value);
+      }
+      /**
+       * Pushes count nil values. The slots hold no heap values, so writing the nil tag over them is enough.
+       * @throw RuntimeError if the stack has not enough room left.
+       */
+      inline void pushNils(size_t count) {
+         if (count > mCapacity - mSize)
+            overflow();
+         for (Value* pValue = mpValues + mSize, *pEnd = pValue + count; pValue != pEnd; pValue++)
+            pValue->mBits = Value::kTagNil;
+         mSize += count;
+      }
+      /**
+       * Moves the top up to size, making the slots in between part of the stack with their current content.
+       * @throw RuntimeError if size exceeds the capacity.
+       */
+      inline void grow(size_t size) {
+         if (size > mCapacity)
+            overflow();
+         mSize = size;
+      }
+      /**
+       * Moves the count values starting at index distance slots up, leaving nil behind them. It is a plain copy of bits
+       * since the destination slots are expected to be nil already.
+       */
+      inline void shift(size_t index, size_t count, size_t distance) {
+         for (size_t i = index + count; i-- > index;) {
+            mpValues[i + distance].mBits = mpValues[i].mBits;
+            mpValues[i].mBits = Value::kTagNil;
+         }
+      }
+      /**
+       * Moves the count values starting at index to destination, in either direction, leaving nil behind them. As for
+       * shift() the destination slots are expected to be nil already.
+       */
+      inline void relocate(size_t index, size_t count, size_t destination) {
+         if (destination > index)
+            shift(index, count, destination - index);
+         else if (destination < index) {
+            for (size_t i = 0; i < count; i++) {
+               mpValues[destination + i].mBits = mpValues[index + i].mBits;
+               mpValues[index + i].mBits = Value::kTagNil;
+            }
+         }
+      }
+      /**
+       * Removes the value on top of the stack.
+       */
+      inline void pop() {
+         release(mpValues[--mSize]);
+      }
+      /**
+       * Removes the values above the first size ones.
+       */
+      inline void truncate(size_t size) {
+         while (mSize > size)
+            release(mpValues[--mSize]);
+      }
+      /**
+       * Removes all the values.
+       */
+      inline void clear() {
+         truncate(0);
+      }
+      /**
+       * Removes all the values and releases every slot above the top too, as execution may have been interrupted while call
+       * arguments were being prepared.
+       */
+      void reset();
+      /**
+       * Exchanges the content of two stacks without moving any value, so pointers to their values stay valid.
+       */
+      inline void swap(ValueStack& other) {
+         std::swap(mpValues, other.mpValues);
+         std::swap(mSize, other.mSize);
+         std::swap(mCapacity, other.mCapacity);
+      }
+
+   private:
+      Value* mpValues;
+      size_t mSize;
+      size_t mCapacity;
+
+      ValueStack(const ValueStack&);
+      ValueStack& operator=(const ValueStack&);
+
+      /**
+       * Turns given slot back to nil. Only heap values need any work.
+       */
+      static inline void release(Value& value) {
+         if (value.isHeapValue()) {
+            value.cleanup();
+            value.mBits = Value::kTagNil;
+         }
+      }
+      /**
+       * @throw RuntimeError reporting a stack overflow.
+       */
+      void overflow() const;
+   };
+}
+
+#endif	/* ION_SCRIPT_VALUE_STACK_H */
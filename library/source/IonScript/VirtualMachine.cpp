@@ -23,54 +23,44 @@
  ******************************************************************************/
 
 #include "VirtualMachine.h"
+#include "Array.h"
 #include "Exceptions.h"
 #include "Parser.h"
 #include "SyntaxTree.h"
 #include "OpCode.h"
 #include "Bytecode.h"
 #include "Compiler.h"
+#include "Program.h"
+#include "Dictionary.h"
+#include "Fiber.h"
 
 #include <vector>
+#include <utility>
 #include <map>
+#include <cmath>
+#include <algorithm>
 
 using namespace ionscript;
 using namespace std;
 
-enum
-{
-	BFID_PRINT,
-	BFID_POST,
-	BFID_GET,
-	BFID_LEN,
-	BFID_APPEND,
-	BFID_REMOVE,
-	BFID_ASSERT,
-	BFID_DUMP,
-	BFID_STR,
-	BFID_JOIN,
-	BFID_ERROR,
-};
-
-VirtualMachine::VirtualMachine() : mpProgram(0)
-{
-	HostFunctionGroupID hfgID = registerHostFunctionGroup(builtinsGroup);
-	setFunction("print", hfgID, BFID_PRINT, 0, -1);
-	setFunction("post", hfgID, BFID_POST, 2);
-	setFunction("get", hfgID, BFID_GET, 1);
-	setFunction("len", hfgID, BFID_LEN, 1);
-	setFunction("append", hfgID, BFID_APPEND, 2);
-	setFunction("remove", hfgID, BFID_REMOVE, 2);
-	setFunction("assert", hfgID, BFID_ASSERT, 1, 2);
-	setFunction("dump", hfgID, BFID_DUMP); // no arguments
-	setFunction("str", hfgID, BFID_STR, 1);
-	setFunction("join", hfgID, BFID_JOIN, 2, -1);
-	setFunction("error", hfgID, BFID_ERROR, 1);
+namespace
+{
+	/** Activation frames reserved when a program is run, only deeper calls make the frames array grow. */
+	const size_t kActivationsCapacity = 256;
+	/** Activation frames reserved when a fiber is created. */
+	const size_t kFiberActivationsCapacity = 16;
+}
+
+VirtualMachine::VirtualMachine(size_t stackCapacity) : mState(STATE_FINISHED), mIP(0), mValues(stackCapacity),
+mHostFunctionArgumentsCount(0), mHostFunctionReturnLocation(0), mpFiber(0), mpGlobals(0), mRunsCount(0), mpAllocator(mDefaultAllocator.get())
+{
+	registerBuiltins();
 }
 
 VirtualMachine::~VirtualMachine()
 {
-	if (mpProgram)
-		delete mpProgram;
+	for (size_t i = 0; i < mBindings.size(); i++)
+		delete mBindings[i];
 }
 
 HostFunctionGroupID VirtualMachine::registerHostFunctionGroup(HostFunction function)
@@ -79,7 +69,7 @@ HostFunctionGroupID VirtualMachine::registerHostFunctionGroup(HostFunction funct
 	return mHostFunctionGroups.size() - 1;
 }
 
-void VirtualMachine::setFunction(const std::string& name, HostFunctionGroupID hostFunctionID, FunctionID functionID, int minArgumentsCount, int maxArgumentsCount)
+void VirtualMachine::setFunction(const std::string& name, HostFunctionGroupID hostFunctionID, FunctionID functionID, int minArgumentsCount, int maxArgumentsCount, bool maySuspend)
 {
 	if (maxArgumentsCount == -2 || (maxArgumentsCount != -1 && maxArgumentsCount < minArgumentsCount))
 		maxArgumentsCount = minArgumentsCount;
@@ -89,10 +79,34 @@ void VirtualMachine::setFunction(const std::string& name, HostFunctionGroupID ho
 	info.fID = functionID;
 	info.minArgumentsCount = minArgumentsCount;
 	info.maxArgumentsCount = maxArgumentsCount;
+	info.bindingID = -1;
+	info.maySuspend = maySuspend;
+	info.intrinsic = -1;
+
+	mHostFunctionsMap[name] = info;
+}
+
+void VirtualMachine::bindFunction(const std::string& name, HostBinding* pBinding, int argumentsCount)
+{
+	mBindings.push_back(pBinding);
+
+	FunctionInfo info;
+	info.hfgID = 0;
+	info.fID = 0;
+	info.minArgumentsCount = argumentsCount;
+	info.maxArgumentsCount = argumentsCount;
+	info.bindingID = mBindings.size() - 1;
+	info.maySuspend = false;
+	info.intrinsic = -1;
 
 	mHostFunctionsMap[name] = info;
 }
 
+void VirtualMachine::setIntrinsic(const std::string& name, OpCode op)
+{
+	mHostFunctionsMap[name].intrinsic = op;
+}
+
 void VirtualMachine::post(const std::string& name, const Value& value)
 {
 	mGlobalVariables[name] = value;
@@ -134,32 +148,47 @@ void VirtualMachine::compile(std::istream& source, std::vector<char>& output, Sy
 
 void VirtualMachine::run(char* program)
 {
-	delete mpProgram;
-	mpProgram = new BytecodeReader(program);
+	// Decode the bytecode once, the dispatch loop only deals with the resulting instructions.
+	run(std::shared_ptr<const Program>(new Program(program)));
+}
+
+void VirtualMachine::run(const std::shared_ptr<const Program>& program)
+{
+	if (mpFiber)
+		error("a fiber cannot run a program.");
 
-	unsigned int magicNumber, version;
-	size_t size;
-	*mpProgram >> magicNumber >> version >> size;
+	if (program != mpProgram)
+	{
+		mpProgram = program;
+		mCode.assign(program->getInstructions(), program->getInstructions() + program->getInstructionsCount());
+
+		mStrings.clear();
+		mStrings.reserve(program->getStringsCount());
+		for (size_t i = 0; i < program->getStringsCount(); i++)
+			mStrings.push_back(Value(program->getString(i)));
+	}
+	mIP = 0;
 
-	if (magicNumber != kMagicNumber)
-		throw RuntimeError("Given bytes do not form a valid bytecode.");
-	if (version > kVersion)
-		throw RuntimeError("Given bytecode has version higher than this Virtual Machine one.");
+	mCallCaches.assign(mpProgram->getCallSitesCount(), CallCache());
 
-	mValues.clear();
-	mValues.reserve(40);
+	// A run interrupted by an error may have left call arguments above the top of the stack.
+	if (mState == STATE_FINISHED)
+		mValues.clear();
+	else
+		mValues.reset();
 
 	mActivations.clear();
+	mActivations.reserve(kActivationsCapacity);
 	mActivations.push_back(ActivationRecord());
+	mpGlobals = mValues.data();
+	mRunsCount++;
 
-	mState = STATE_RUNNING;
-
-	while (mpProgram->continues() && mState == STATE_RUNNING)
-		executeInstruction();
+	// The values of the previous run have been released: an arena can start over.
+	mpAllocator->reset();
 
-	// The loop exited because we executed the whole program
-	if (mState == STATE_RUNNING)
-		mState = STATE_FINISHED;
+	Allocator::Scope allocatorScope(mpAllocator);
+	mState = STATE_RUNNING;
+	execute();
 }
 
 void VirtualMachine::compileAndRun(const std::string& filename)
@@ -187,14 +216,9 @@ void VirtualMachine::goOn()
 	if (mState != STATE_PAUSED)
 		return;
 
+	Allocator::Scope allocatorScope(mpAllocator);
 	mState = STATE_RUNNING;
-
-	while (mpProgram->continues() && mState == STATE_RUNNING)
-		executeInstruction();
-
-	// The loop exited because we executed the whole program
-	if (mState == STATE_RUNNING)
-		mState = STATE_FINISHED;
+	execute();
 }
 
 Value VirtualMachine::callScriptFunction(const Value& function, const Value& argument)
@@ -214,632 +238,1049 @@ Value VirtualMachine::callScriptFunction(const Value& function, const Value** ar
 	function.assertType(Value::TYPE_SCRIPT_FUNCTION);
 
 	// Check whether the required number of arguments corresponds to the one given.
-	if (function.mnArguments != nArguments)
+	if (function.getFunctionArgumentsCount() != nArguments)
 	{
 		stringstream ss;
-		ss << "wrong number of arguments given (" << (int) nArguments << " instead of " << (int) function.mnArguments << ").";
+		ss << "wrong number of arguments given (" << (int) nArguments << " instead of " << (int) function.getFunctionArgumentsCount() << ").";
 		error(ss.str());
 	}
-	index_t oldIP = mpProgram->getCursorPosition();
+	index_t oldIP = mIP;
+	State oldState = mState;
+	size_t oldHostFunctionArgumentsCount = mHostFunctionArgumentsCount;
+	size_t oldHostFunctionReturnLocation = mHostFunctionReturnLocation;
+
+	// The frame is built on top of the stack, the returned value is left in its first slot.
+	size_t window = mValues.size();
 
 	// Push registers
-	for (size_t i = 0; i < function.mnFunctionRegisters; i++)
-		mValues.push_back(Value());
+	mValues.pushNils(function.getFunctionRegistersCount());
 
 	// Push arguments
 	for (size_t i = 0; i < nArguments; i++)
-		mValues.push_back(*argument[i]);
+		mValues.push(*argument[i]);
 
 	// Finally set the current IP
-	mpProgram->setCursorPosition(function.mFunctionIndex);
+	mIP = function.getFunctionIndex();
 
-	ActivationRecord record(0, mValues.size() - function.mnFunctionRegisters - nArguments, mValues.size() - nArguments);
-	mActivations.push_back(record);
+	mActivations.emplace_back(0, window, window + function.getFunctionRegistersCount(), window);
 
-	while (mpProgram->getCursorPosition() != 0)
-		executeInstruction();
+	// Run until the function returns (see OP_RETURN and OP_RETURN_NIL)
+	{
+		Allocator::Scope allocatorScope(mpAllocator);
+		mState = STATE_RUNNING;
+		execute();
+	}
 
-	mpProgram->setCursorPosition(oldIP);
+	if (mIP != 0)
+		error("a script function called by the host cannot be suspended.");
 
-	// Pop the result and return it
-	Value result = mValues.back();
-	mValues.pop_back();
+	mIP = oldIP;
+	mState = oldState;
+	mHostFunctionArgumentsCount = oldHostFunctionArgumentsCount;
+	mHostFunctionReturnLocation = oldHostFunctionReturnLocation;
 
-	return result;
+	// Take the result, the slot is above the top of the stack and must be left nil
+	return Value(std::move(mValues[window]));
 }
 
-void VirtualMachine::dump(std::ostream & output)
+Fiber* VirtualMachine::createFiber(const Value& function)
 {
-	output << "Values-Stack:\n";
-	for (size_t i = 0; i < mValues.size(); ++i)
-		output << "   " << i << ", " << (long) i - (long) mActivations.back().firstVariableLocation << ") " << mValues[i].toString() << "\n";
+	return createFiber(function, 0, 0);
+}
 
-	output << "Activations-Stack:\n";
-	list<ActivationRecord>::const_iterator it = mActivations.begin();
-	size_t i = 0;
-	for (; it != mActivations.end(); ++it)
+Fiber* VirtualMachine::createFiber(const Value& function, const Value& argument)
+{
+	const Value * arguments[] = {&argument};
+	return createFiber(function, arguments, 1);
+}
+
+Fiber* VirtualMachine::createFiber(const Value& function, const Value** arguments, size_t nArguments, size_t stackCapacity)
+{
+	if (!mpProgram)
+		error("a program must be loaded to create fibers.");
+	checkCall(function, nArguments);
+
+	Fiber* pFiber = new Fiber(stackCapacity, mRunsCount);
+	try
 	{
-		output << "   " << i << ") " <<
-			"return-index : " << it->returnIndex << ";" <<
-			"stack-size: " << it->stackSize << ";" <<
-			"first-variable-loc: " << it->firstVariableLocation << "\n";
-		i++;
+		// The frame is built as callScriptFunction() does, the returned value is left in the first slot of the stack.
+		pFiber->mValues.pushNils(function.getFunctionRegistersCount());
+		for (size_t i = 0; i < nArguments; i++)
+			pFiber->mValues.push(*arguments[i]);
+	} catch (...)
+	{
+		delete pFiber;
+		throw;
 	}
+
+	pFiber->mActivations.reserve(kFiberActivationsCapacity);
+	pFiber->mActivations.emplace_back(0, 0, function.getFunctionRegistersCount(), 0);
+	pFiber->mIP = function.getFunctionIndex();
+	return pFiber;
 }
-//
 
-void VirtualMachine::executeInstruction()
+void VirtualMachine::resume(Fiber& fiber)
 {
-	OpCode op;
-	*mpProgram >> op;
+	if (fiber.mRunID != mRunsCount)
+		error("the fiber belongs to a program which is not loaded anymore.");
+	if (fiber.mActive)
+		error("the fiber is already running.");
+	if (fiber.mState != STATE_PAUSED)
+		return;
 
-	switch (op)
+	Fiber* pResumer = mpFiber;
+	swapExecution(fiber);
+	fiber.mActive = true;
+	mpFiber = &fiber;
+
+	try
 	{
-		case OP_REG:
+		Allocator::Scope allocatorScope(mpAllocator);
+		if (fiber.mHasPendingResult)
 		{
-			small_size_t nRegisters;
-			*mpProgram >> nRegisters;
-			for (size_t i = 0; i < nRegisters; i++)
-				mValues.push_back(Value());
-			mActivations.back().firstVariableLocation += nRegisters;
-			return;
+			fiber.mHasPendingResult = false;
+			mState = STATE_WAITING_FOR_RETURN;
+			returnValue(fiber.mPendingResult, &fiber);
+			fiber.mPendingResult.setNil();
 		}
 
-		case OP_PCALL_SF_L:
-		case OP_PCALL_SF_G:
+		mState = STATE_RUNNING;
+		execute();
+
+		// Still running means that the function returned, see OP_RETURN and OP_RETURN_NIL.
+		if (mState == STATE_RUNNING)
 		{
-			location_t functionLoc;
-			*mpProgram >> functionLoc;
-
-			Value functionValue;
-			if (op == OP_PCALL_SF_G)
-				functionValue = mValues[mActivations.front().firstVariableLocation + functionLoc]; // global
-			else
-				functionValue = mValues[mActivations.back().firstVariableLocation + functionLoc]; //local
-
-			for (size_t i = 0; i < functionValue.mnFunctionRegisters; i++)
-				mValues.push_back(Value());
-			return;
+			fiber.mResult = std::move(mValues[0]);
+			mState = STATE_FINISHED;
 		}
+	} catch (...)
+	{
+		// Call arguments may have been left above the top of the stack.
+		mValues.reset();
+		mActivations.clear();
+		mState = STATE_FINISHED;
 
-		case OP_CALL_SF_L:
-		case OP_CALL_SF_G:
-		{
-			location_t functionLoc;
-			small_size_t nArguments;
-			*mpProgram >> functionLoc >> nArguments;
+		mpFiber = pResumer;
+		fiber.mActive = false;
+		swapExecution(fiber);
+		throw;
+	}
+
+	mpFiber = pResumer;
+	fiber.mActive = false;
+	swapExecution(fiber);
+}
+
+void VirtualMachine::resume(Fiber& fiber, const Value& result)
+{
+	if (fiber.mActive)
+		error("the fiber is already running.");
+
+	returnValue(result, &fiber);
+	resume(fiber);
+}
+
+void VirtualMachine::swapExecution(Fiber& fiber)
+{
+	mValues.swap(fiber.mValues);
+	mActivations.swap(fiber.mActivations);
+	std::swap(mIP, fiber.mIP);
+	std::swap(mState, fiber.mState);
+	std::swap(mHostFunctionArgumentsCount, fiber.mHostFunctionArgumentsCount);
+	std::swap(mHostFunctionReturnLocation, fiber.mHostFunctionReturnLocation);
+}
+
+void VirtualMachine::dump(std::ostream & output)
+{
+	output << "Values-Stack:\n";
+	for (size_t i = 0; i < mValues.size(); ++i)
+		output << "   " << i << ", " << (long) i - (long) mActivations.back().firstVariableLocation << ") " << mValues[i].toString() << "\n";
+
+	output << "Activations-Stack:\n";
+	for (size_t i = 0; i < mActivations.size(); ++i)
+	{
+		output << "   " << i << ") " <<
+			"return-index : " << mActivations[i].returnIndex << ";" <<
+			"stack-size: " << mActivations[i].stackSize << ";" <<
+			"first-variable-loc: " << mActivations[i].firstVariableLocation << "\n";
+	}
+}
+//
 
-			Value functionValue;
-			if (op == OP_CALL_SF_G)
-				functionValue = mValues[mActivations.front().firstVariableLocation + functionLoc]; // global
-			else
-				functionValue = mValues[mActivations.back().firstVariableLocation + functionLoc]; //local
+/*
+ * The dispatch loop is threaded by means of computed gotos when the compiler supports them (GCC and Clang) so that every
+ * handler jumps directly to the next one instead of going back through the single indirect jump of a switch. Define
+ * ION_SCRIPT_SWITCH_DISPATCH to fall back to the portable switch-based loop.
+ */
+#if defined(__GNUC__) && !defined(ION_SCRIPT_SWITCH_DISPATCH)
+#define ION_SCRIPT_COMPUTED_GOTO
+#endif
+
+#ifdef ION_SCRIPT_COMPUTED_GOTO
+#define VM_CASE(op) L_##op
+#define VM_DISPATCH() goto *kDispatchTable[ip->op]
+#else
+#define VM_CASE(op) case op
+#define VM_DISPATCH() goto L_DISPATCH
+#endif
+
+/* Executes the instruction that follows the current one. */
+#define VM_NEXT() \
+	do { \
+		++ip; \
+		VM_DISPATCH(); \
+	} while (0)
+
+/* Executes the instruction at given index. */
+#define VM_JUMP(index) \
+	do { \
+		ip = code + (index); \
+		VM_DISPATCH(); \
+	} while (0)
+
+/* Leaves the loop saving the position of the instruction pointed by ip. */
+#define VM_EXIT() \
+	do { \
+		mIP = ip - code; \
+		return; \
+	} while (0)
+
+/* Reloads the pointer to the locals of the current activation frame after calls and returns. */
+#define VM_LOAD_BASE() \
+	do { \
+		base = mValues.data() + mActivations.back().firstVariableLocation; \
+	} while (0)
+
+/* Leaves the loop if the VM is not running anymore. It's only checked at back-edges, calls and host functions returns. */
+#define VM_CHECK_STATE() \
+	do { \
+		if (mState != STATE_RUNNING) \
+			VM_EXIT(); \
+	} while (0)
+
+/* Generic arithmetic operation. When both operands are numbers the result is computed inline and the instruction is quickened. */
+#define VM_ARITHMETIC(quickenedOp, operator) \
+	do { \
+		Value& left = base[ip->b]; \
+		Value& right = base[ip->c]; \
+		if (left.isNumber() && right.isNumber()) \
+		{ \
+			ip->op = quickenedOp; \
+			base[ip->a].setNumber(left.getNumber() operator right.getNumber()); \
+			VM_NEXT(); \
+		} \
+		base[ip->a] = left operator right; \
+		VM_NEXT(); \
+	} while (0)
+
+/* Quickened arithmetic operation. If an operand is not a number anymore, the generic instruction is restored and executed. */
+#define VM_ARITHMETIC_NN(genericOp, operator) \
+	do { \
+		Value& left = base[ip->b]; \
+		Value& right = base[ip->c]; \
+		if (left.isNumber() && right.isNumber()) \
+		{ \
+			base[ip->a].setNumber(left.getNumber() operator right.getNumber()); \
+			VM_NEXT(); \
+		} \
+		ip->op = genericOp; \
+		VM_DISPATCH(); \
+	} while (0)
+
+/* Generic comparison. When both operands are numbers the result is computed inline and the instruction is quickened. */
+#define VM_COMPARISON(quickenedOp, operator) \
+	do { \
+		Value& left = base[ip->b]; \
+		Value& right = base[ip->c]; \
+		if (left.isNumber() && right.isNumber()) \
+		{ \
+			ip->op = quickenedOp; \
+			base[ip->a].setBoolean(left.getNumber() operator right.getNumber()); \
+			VM_NEXT(); \
+		} \
+		base[ip->a] = left operator right; \
+		VM_NEXT(); \
+	} while (0)
+
+/* Quickened comparison. If an operand is not a number anymore, the generic instruction is restored and executed. */
+#define VM_COMPARISON_NN(genericOp, operator) \
+	do { \
+		Value& left = base[ip->b]; \
+		Value& right = base[ip->c]; \
+		if (left.isNumber() && right.isNumber()) \
+		{ \
+			base[ip->a].setBoolean(left.getNumber() operator right.getNumber()); \
+			VM_NEXT(); \
+		} \
+		ip->op = genericOp; \
+		VM_DISPATCH(); \
+	} while (0)
+
+/* Generic compare-and-branch, quickened when both operands are numbers. It jumps if the comparison is false. */
+#define VM_JUMP_COMPARISON(quickenedOp, operator) \
+	do { \
+		Value& left = base[ip->a]; \
+		Value& right = base[ip->b]; \
+		if (left.isNumber() && right.isNumber()) \
+		{ \
+			ip->op = quickenedOp; \
+			if (!(left.getNumber() operator right.getNumber())) \
+				VM_JUMP(ip->c); \
+			VM_NEXT(); \
+		} \
+		if (!(left operator right)) \
+			VM_JUMP(ip->c); \
+		VM_NEXT(); \
+	} while (0)
+
+/* Quickened compare-and-branch. If an operand is not a number anymore, the generic instruction is restored and executed. */
+#define VM_JUMP_COMPARISON_NN(genericOp, operator) \
+	do { \
+		Value& left = base[ip->a]; \
+		Value& right = base[ip->b]; \
+		if (left.isNumber() && right.isNumber()) \
+		{ \
+			if (!(left.getNumber() operator right.getNumber())) \
+				VM_JUMP(ip->c); \
+			VM_NEXT(); \
+		} \
+		ip->op = genericOp; \
+		VM_DISPATCH(); \
+	} while (0)
+
+/* Arithmetic operation with a constant second operand. */
+#define VM_ARITHMETIC_IMMEDIATE(operator) \
+	do { \
+		Value& left = base[ip->b]; \
+		if (left.isNumber()) \
+			base[ip->a].setNumber(left.getNumber() operator numbers[ip->c]); \
+		else \
+			base[ip->a] = left operator Value(numbers[ip->c]); \
+		VM_NEXT(); \
+	} while (0)
+
+/* Comparison with a constant second operand. */
+#define VM_COMPARISON_IMMEDIATE(operator) \
+	do { \
+		Value& left = base[ip->b]; \
+		if (left.isNumber()) \
+			base[ip->a].setBoolean(left.getNumber() operator numbers[ip->c]); \
+		else \
+			base[ip->a] = left operator Value(numbers[ip->c]); \
+		VM_NEXT(); \
+	} while (0)
+
+/* Compare-and-branch with a constant second operand. It jumps if the comparison is false. */
+#define VM_JUMP_COMPARISON_IMMEDIATE(operator) \
+	do { \
+		Value& left = base[ip->a]; \
+		if (left.isNumber() ? !(left.getNumber() operator numbers[ip->b]) : !(left operator Value(numbers[ip->b]))) \
+			VM_JUMP(ip->c); \
+		VM_NEXT(); \
+	} while (0)
+
+void VirtualMachine::execute()
+{
+	Instruction * const code = mCode.data();
+	Instruction* ip = code + mIP;
+	const double * const numbers = mpProgram->getNumbers();
+	// The globals are the locals of the first frame of the program, even when a fiber runs on its own stack.
+	Value* globals = mpGlobals;
+	Value* base;
+	VM_LOAD_BASE();
+
+#ifdef ION_SCRIPT_COMPUTED_GOTO
+	// It must follow the OpCode enumeration order.
+	static const void* const kDispatchTable[] = {
+		&&L_OP_NOP, &&L_OP_REG, &&L_OP_PUSH, &&L_OP_PUSH_N, &&L_OP_PUSH_S, &&L_OP_PUSH_B, &&L_OP_POP, &&L_OP_POP_N,
+		&&L_OP_STORE_AT_NIL, &&L_OP_STORE_AT_F, &&L_OP_MOVE, &&L_OP_ADD, &&L_OP_SUB, &&L_OP_MUL, &&L_OP_DIV, &&L_OP_INC,
+		&&L_OP_DEC, &&L_OP_ADDI, &&L_OP_SUBI, &&L_OP_MULI, &&L_OP_DIVI, &&L_OP_NOT, &&L_OP_AND, &&L_OP_OR, &&L_OP_EQ,
+		&&L_OP_NEQ, &&L_OP_GR, &&L_OP_GRE, &&L_OP_LS, &&L_OP_LSE, &&L_OP_EQI, &&L_OP_NEQI, &&L_OP_GRI, &&L_OP_GREI,
+		&&L_OP_LSI, &&L_OP_LSEI, &&L_OP_JUMP, &&L_OP_JUMP_COND, &&L_OP_JEQ, &&L_OP_JNEQ, &&L_OP_JGR, &&L_OP_JGRE, &&L_OP_JLS,
+		&&L_OP_JLSE, &&L_OP_JEQI, &&L_OP_JNEQI, &&L_OP_JGRI, &&L_OP_JGREI, &&L_OP_JLSI, &&L_OP_JLSEI, &&L_OP_RETURN_NIL,
+		&&L_OP_RETURN, &&L_OP_CALL_SF_G, &&L_OP_CALL_SF_L, &&L_OP_TAIL_CALL_SF_G, &&L_OP_TAIL_CALL_SF_L, &&L_OP_CALL_HF,
+		&&L_OP_CALL_HF_S, &&L_OP_CALL_BF, &&L_OP_LIST_NEW, &&L_OP_LIST_ADD, &&L_OP_DICTIONARY_NEW, &&L_OP_DICTIONARY_ADD,
+		&&L_OP_GET, &&L_OP_SET, &&L_OP_SLICE, &&L_OP_LEN, &&L_OP_APPEND, &&L_OP_FLOOR, &&L_OP_SQRT, &&L_OP_ABS, &&L_OP_MIN,
+		&&L_OP_MAX, &&L_OP_HALT, &&L_OP_ADD_NN, &&L_OP_SUB_NN, &&L_OP_MUL_NN, &&L_OP_DIV_NN, &&L_OP_GR_NN, &&L_OP_GRE_NN,
+		&&L_OP_LS_NN, &&L_OP_LSE_NN, &&L_OP_JGR_NN, &&L_OP_JGRE_NN, &&L_OP_JLS_NN, &&L_OP_JLSE_NN,
+	};
+
+	VM_DISPATCH();
+#else
+L_DISPATCH:
+	switch (ip->op)
+	{
+#endif
+			VM_CASE(OP_NOP):
+				VM_NEXT();
+
+			VM_CASE(OP_REG):
+			{
+				mValues.pushNils(ip->a);
+				mActivations.back().firstVariableLocation += ip->a;
+				VM_LOAD_BASE();
+				if (mActivations.size() == 1 && !mpFiber)
+					mpGlobals = globals = base;
+				VM_NEXT();
+			}
 
-			if (functionValue.mType == Value::TYPE_SCRIPT_FUNCTION)
+			VM_CASE(OP_CALL_SF_L):
+			VM_CASE(OP_CALL_SF_G):
 			{
-				// Check whether the required number of arguments corresponds to the one given.
-				if (functionValue.mnArguments != nArguments)
+				size_t nArguments = ip->b >> 8;
+				size_t entry, nRegisters;
+
+				// Global functions are checked only when the call site cache misses, that is the first time or after the global
+				// has been reassigned.
+				if (ip->op == OP_CALL_SF_G)
 				{
-					stringstream ss;
-					ss << "wrong number of arguments given (" << (int) nArguments << " instead of " << (int) functionValue.mnArguments << ").";
-					error(ss.str());
+					CallCache& cache = mCallCaches[ip->a >> 8];
+					const Value& functionValue = globals[ip->a & 0xFF];
+					if (functionValue.mBits != cache.function)
+						fillCallCache(cache, functionValue, nArguments);
+					entry = cache.entry;
+					nRegisters = cache.nRegisters;
 				}
+				else
+				{
+					const Value& functionValue = base[ip->a];
+					checkCall(functionValue, nArguments);
+					entry = functionValue.getFunctionIndex();
+					nRegisters = functionValue.getFunctionRegistersCount();
+				}
+
+				// The arguments are already in the window, the callee's registers go right below them.
+				size_t window = base + (ip->b & 0xFF) - mValues.data();
+				mValues.grow(window + nRegisters + nArguments);
+				if (nRegisters > 0)
+					mValues.shift(window, nArguments, nRegisters);
 
-				ActivationRecord record(mpProgram->getCursorPosition(), mValues.size() - functionValue.mnFunctionRegisters - nArguments, mValues.size() - nArguments);
-				mActivations.push_back(record);
+				mActivations.emplace_back(ip + 1 - code, window, window + nRegisters, base + ip->c - mValues.data());
+				VM_LOAD_BASE();
 
 				// Finally set the current IP
-				mpProgram->setCursorPosition(functionValue.mFunctionIndex);
-			} else
-				throw RuntimeError("object " + functionValue.toString() + " is not callable.");
-			return;
-		}
+				ip = code + entry;
 
+				VM_CHECK_STATE();
+				VM_DISPATCH();
+			}
 
-		case OP_CALL_HF:
-		{
-			HostFunctionGroupID hfgID;
-			FunctionID fID;
-			small_size_t nArguments;
-			*mpProgram >> hfgID >> fID >> nArguments;
+			VM_CASE(OP_TAIL_CALL_SF_L):
+			VM_CASE(OP_TAIL_CALL_SF_G):
+			{
+				size_t nArguments = ip->b >> 8;
+				size_t entry, nRegisters;
 
-			FunctionCallManager manager(*this, fID, &mValues[mValues.size() - nArguments], nArguments);
+				// Read before the current frame is released, the function may be one of its locals.
+				if (ip->op == OP_TAIL_CALL_SF_G)
+				{
+					CallCache& cache = mCallCaches[ip->a >> 8];
+					const Value& functionValue = globals[ip->a & 0xFF];
+					if (functionValue.mBits != cache.function)
+						fillCallCache(cache, functionValue, nArguments);
+					entry = cache.entry;
+					nRegisters = cache.nRegisters;
+				}
+				else
+				{
+					const Value& functionValue = base[ip->a];
+					checkCall(functionValue, nArguments);
+					entry = functionValue.getFunctionIndex();
+					nRegisters = functionValue.getFunctionRegistersCount();
+				}
 
-			// Set the number of arguments
-			mHostFunctionArgumentsCount = nArguments;
+				// Release the current frame but the arguments in the window, then build the callee's frame in its place.
+				// The record keeps the return index and location, so that the callee returns straight to our caller.
+				ActivationRecord& record = mActivations.back();
+				size_t window = base + (ip->b & 0xFF) - mValues.data();
+				mValues.truncate(record.stackSize);
+				mValues.grow(max(window, record.stackSize + nRegisters) + nArguments);
+				mValues.relocate(window, nArguments, record.stackSize + nRegisters);
+				mValues.truncate(record.stackSize + nRegisters + nArguments);
 
-			// Pause the machine
-			mState = STATE_WAITING_FOR_RETURN;
+				record.firstVariableLocation = record.stackSize + nRegisters;
+				VM_LOAD_BASE();
 
-			// Call the host function group.
-			mHostFunctionGroups[hfgID](manager);
+				ip = code + entry;
 
-			// If the state is PAUSED it means that the function already returned a value so we can continue
-			if (mState == STATE_PAUSED)
-				mState = STATE_RUNNING;
+				VM_CHECK_STATE();
+				VM_DISPATCH();
+			}
 
-			break;
-		}
+			VM_CASE(OP_CALL_HF):
+			{
+				size_t nArguments = ip->b >> 8;
 
-		case OP_RETURN_NIL:
-		{
-			// Restore the stack as it was before
-			while (mValues.size() > mActivations.back().stackSize)
-				mValues.pop_back();
+				// The arguments become part of the stack for the duration of the call, so that the host can call script functions.
+				size_t window = base + (ip->b & 0xFF) - mValues.data();
+				mValues.grow(window + nArguments);
 
-			// Return a nil value
-			mValues.push_back(Value());
+				// The function returns straight into result (nil if it returns nothing), no state change is involved.
+				{
+					Value result;
+					FunctionCallManager manager(*this, ip->a & 0xFF, mValues.data() + window, nArguments, &result, mpFiber);
+					mHostFunctionGroups[ip->a >> 8](manager);
 
-			// Set the Instruction Pointer
-			mpProgram->setCursorPosition(mActivations.back().returnIndex);
+					mValues.truncate(window);
+					base[ip->c] = std::move(result);
+				}
 
-			mActivations.pop_back();
+				++ip;
+				VM_CHECK_STATE();
+				VM_DISPATCH();
+			}
 
-			return;
-		}
+			VM_CASE(OP_CALL_HF_S):
+			{
+				size_t nArguments = ip->b >> 8;
 
-		case OP_RETURN:
-		{
-			location_t loc;
-			*mpProgram >> loc;
+				size_t window = base + (ip->b & 0xFF) - mValues.data();
+				mValues.grow(window + nArguments);
 
-			Value returnValue = getLocalValue(loc);
+				FunctionCallManager manager(*this, ip->a & 0xFF, mValues.data() + window, nArguments, 0, mpFiber);
 
-			// Restore the stack as it was before
-			while (mValues.size() > mActivations.back().stackSize)
-				mValues.pop_back();
+				// Set the number of arguments and where the returned value goes
+				mHostFunctionArgumentsCount = nArguments;
+				mHostFunctionReturnLocation = base + ip->c - mValues.data();
 
-			// Return a nil value
-			mValues.push_back(returnValue);
+				// Pause the machine
+				mState = STATE_WAITING_FOR_RETURN;
 
-			// Set the Instruction Pointer
-			mpProgram->setCursorPosition(mActivations.back().returnIndex);
+				// Call the host function group.
+				mHostFunctionGroups[ip->a >> 8](manager);
 
-			mActivations.pop_back();
+				// If the state is PAUSED it means that the function already returned a value so we can continue
+				if (mState == STATE_PAUSED)
+					mState = STATE_RUNNING;
 
-			return;
-		}
+				++ip;
+				VM_CHECK_STATE();
+				VM_DISPATCH();
+			}
 
-		case OP_PUSH:
-			mValues.push_back(Value());
-			return;
+			VM_CASE(OP_CALL_BF):
+			{
+				size_t nArguments = ip->b >> 8;
 
-		case OP_POP:
-			mValues.pop_back();
-			return;
+				// As for host function groups the arguments are part of the stack during the call, then the binding stores the
+				// result straight into the target.
+				size_t window = base + (ip->b & 0xFF) - mValues.data();
+				mValues.grow(window + nArguments);
 
-		case OP_POP_N:
-		{
-			small_size_t n;
-			*mpProgram >> n;
-			for (size_t i = 0; i < n; i++)
-				mValues.pop_back();
-			return;
-		}
+				mBindings[ip->a]->call(mValues.data() + window, base[ip->c]);
 
-		case OP_POP_TO:
-		{
-			location_t loc;
-			*mpProgram >> loc;
-			getLocalValue(loc) = mValues.back();
-			mValues.pop_back();
-			return;
-		}
+				mValues.truncate(window);
 
-		case OP_PUSH_VAL:
-		{
-			location_t loc;
-			*mpProgram >> loc;
-			mValues.push_back(getLocalValue(loc));
-			return;
-		}
+				++ip;
+				VM_CHECK_STATE();
+				VM_DISPATCH();
+			}
 
-		case OP_PUSH_N:
-		{
-			double value;
-			*mpProgram >> value;
-			mValues.push_back(Value(value));
-			return;
-		}
+			VM_CASE(OP_RETURN_NIL):
+			{
+				const ActivationRecord& record = mActivations.back();
 
-		case OP_PUSH_S:
-		{
-			string value;
-			*mpProgram >> value;
-			mValues.push_back(Value(value));
-			return;
-		}
+				// Restore the stack as it was before and return a nil value
+				mValues.truncate(record.stackSize);
+				mValues[record.returnLocation].setNil();
 
-		case OP_PUSH_B:
-		{
-			bool value;
-			*mpProgram >> value;
-			mValues.push_back(Value(value));
-			break;
-		}
+				// Set the Instruction Pointer
+				ip = code + record.returnIndex;
 
-		case OP_STORE_AT_NIL:
-		{
-			location_t loc;
-			*mpProgram >> loc;
-			getLocalValue(loc).setNil();
-			break;
-		}
+				mActivations.pop_back();
 
-		case OP_STORE_AT_F:
-		{
-			index_t index;
-			location_t loc;
-			small_size_t nArguments, nRegisters;
-			*mpProgram >> loc >> index >> nArguments >> nRegisters;
-			getLocalValue(loc).setFunctionValue(index, nArguments, nRegisters);
-			return;
-		}
+				// The function has been called by the host, give control back to it.
+				if (ip == code)
+					VM_EXIT();
 
-		case OP_LIST_NEW:
-		{
-			location_t listLoc;
-			*mpProgram >> listLoc;
-			getLocalValue(listLoc).setEmptyList();
-			return;
-		}
+				VM_LOAD_BASE();
+				VM_DISPATCH();
+			}
 
-		case OP_LIST_ADD:
-		{
-			location_t listLoc, indexLoc;
-			*mpProgram >> listLoc >> indexLoc;
-			getLocalValue(listLoc).getList().push_back(getLocalValue(indexLoc));
-			return;
-		}
+			VM_CASE(OP_RETURN):
+			{
+				const ActivationRecord& record = mActivations.back();
+				Value returnValue(std::move(base[ip->a]));
 
-		case OP_DICTIONARY_NEW:
-		{
-			location_t dictLoc;
-			*mpProgram >> dictLoc;
-			getLocalValue(dictLoc).setEmptyDictionary();
-			return;
-		}
+				// Restore the stack as it was before and store the value where the caller wants it
+				mValues.truncate(record.stackSize);
+				mValues[record.returnLocation] = std::move(returnValue);
 
-		case OP_DICTIONARY_ADD:
-		{
-			location_t dictLoc, keyLoc, valueLoc;
-			*mpProgram >> dictLoc >> keyLoc >> valueLoc;
-			getLocalValue(dictLoc).getDictionary()[ getLocalValue(keyLoc)] = getLocalValue(valueLoc);
-			return;
-		}
+				// Set the Instruction Pointer
+				ip = code + record.returnIndex;
 
-		case OP_GET:
-		{
-			location_t targetLoc, contLoc, indexLoc;
-			*mpProgram >> targetLoc >> contLoc >> indexLoc;
-			Value& cont = getLocalValue(contLoc);
+				mActivations.pop_back();
+
+				// The function has been called by the host, give control back to it.
+				if (ip == code)
+					VM_EXIT();
+
+				VM_LOAD_BASE();
+				VM_DISPATCH();
+			}
 
-			cont.assertType(Value::TYPE_LIST | Value::TYPE_DICTIONARY);
+			VM_CASE(OP_PUSH):
+				mValues.pushNils(1);
+				VM_NEXT();
 
-			if (cont.isList())
+			VM_CASE(OP_POP):
+				mValues.pop();
+				VM_NEXT();
+
+			VM_CASE(OP_POP_N):
 			{
+				mValues.truncate(mValues.size() - ip->a);
+				VM_NEXT();
+			}
 
-				getLocalValue(indexLoc).assertIsPositiveInteger();
+			VM_CASE(OP_PUSH_N):
+				mValues.push(Value(numbers[ip->a]));
+				VM_NEXT();
 
-				size_t index = static_cast<size_t> (getLocalValue(indexLoc).getNumber());
+			VM_CASE(OP_PUSH_S):
+				mValues.push(mStrings[ip->a]);
+				VM_NEXT();
 
-				if (index >= cont.getList().size())
-					throw RuntimeError("index out of list boundaries.");
+			VM_CASE(OP_PUSH_B):
+				mValues.push(Value(ip->a != 0));
+				VM_NEXT();
 
-				getLocalValue(targetLoc) = cont.getListElement(index);
+			VM_CASE(OP_STORE_AT_NIL):
+				base[ip->a].setNil();
+				VM_NEXT();
 
-			} else
-			{
+			VM_CASE(OP_STORE_AT_F):
+				base[ip->a].setFunctionValue(ip->b, ip->c & 0xFF, (ip->c >> 8) & 0xFF);
+				VM_NEXT();
 
-				Dictionary::const_iterator it = cont.getDictionary().find(getLocalValue(indexLoc));
-				if (it == cont.getDictionary().end())
-					throw RuntimeError("key not found in dictionary.");
-				else
-					getLocalValue(targetLoc) = it->second;
-			}
+			VM_CASE(OP_LIST_NEW):
+				base[ip->a].setEmptyList();
+				VM_NEXT();
 
-			return;
-		}
+			VM_CASE(OP_LIST_ADD):
+				base[ip->a].getList().push_back(base[ip->b]);
+				VM_NEXT();
 
-		case OP_SET:
-		{
-			location_t valueLoc, contLoc, indexLoc;
-			*mpProgram >> valueLoc >> contLoc >> indexLoc;
-			Value& cont = getLocalValue(contLoc);
+			VM_CASE(OP_DICTIONARY_NEW):
+				base[ip->a].setEmptyDictionary();
+				VM_NEXT();
 
-			cont.assertType(Value::TYPE_LIST | Value::TYPE_DICTIONARY);
+			VM_CASE(OP_DICTIONARY_ADD):
+				base[ip->a].getDictionary()[ base[ip->b]] = base[ip->c];
+				VM_NEXT();
 
-			if (cont.isList())
+			VM_CASE(OP_GET):
 			{
+				Value& cont = base[ip->b];
+				const Value& key = base[ip->c];
 
-				getLocalValue(indexLoc).assertIsPositiveInteger();
+				if (cont.isArray())
+				{
+					base[ip->a].setNumber(cont.getArray().get(key));
+					VM_NEXT();
+				}
 
-				size_t index = static_cast<size_t> (getLocalValue(indexLoc).getNumber());
+				cont.assertType(Value::TYPE_LIST | Value::TYPE_DICTIONARY);
 
-				if (index >= cont.getList().size())
-					throw RuntimeError("index out of list boundaries.");
+				if (cont.isList())
+				{
 
-				cont.getList()[index] = getLocalValue(valueLoc);
+					key.assertIsPositiveInteger();
 
-			} else
-				cont.getDictionary()[getLocalValue(indexLoc)] = getLocalValue(valueLoc);
+					size_t index = static_cast<size_t> (key.getNumber());
 
-			return;
-		}
+					if (index >= cont.getListSize())
+						throw RuntimeError("index out of list boundaries.");
 
+					base[ip->a] = cont.readListElement(index);
 
+				} else
+				{
 
-		case OP_MOVE:
-		{
-			location_t loc1, loc2;
-			*mpProgram >> loc1 >> loc2;
-			getLocalValue(loc1) = getLocalValue(loc2);
-			return;
-		}
+					Dictionary::const_iterator it = cont.getDictionary().find(key);
+					if (it == cont.getDictionary().end())
+						throw RuntimeError("key not found in dictionary.");
+					else
+						base[ip->a] = it->second;
+				}
 
-		case OP_ADD:
-		{
-			location_t loc1, loc2, loc3;
-			*mpProgram >> loc1 >> loc2 >> loc3;
-			getLocalValue(loc1) = getLocalValue(loc2) + getLocalValue(loc3);
-			return;
-		}
-		case OP_SUB:
-		{
-			location_t loc1, loc2, loc3;
-			*mpProgram >> loc1 >> loc2 >> loc3;
-			getLocalValue(loc1) = getLocalValue(loc2) - getLocalValue(loc3);
-			return;
-		}
+				VM_NEXT();
+			}
 
-		case OP_MUL:
-		{
-			location_t loc1, loc2, loc3;
-			*mpProgram >> loc1 >> loc2 >> loc3;
-			getLocalValue(loc1) = getLocalValue(loc2) * getLocalValue(loc3);
-			return;
-		}
+			VM_CASE(OP_SET):
+			{
+				Value& cont = base[ip->b];
+				const Value& key = base[ip->c];
 
-		case OP_DIV:
-		{
-			location_t loc1, loc2, loc3;
-			*mpProgram >> loc1 >> loc2 >> loc3;
-			getLocalValue(loc1) = getLocalValue(loc2) / getLocalValue(loc3);
-			return;
-		}
+				if (cont.isArray())
+				{
+					cont.getArray().set(key, base[ip->a]);
+					VM_NEXT();
+				}
 
-		case OP_JUMP:
-		{
-			index_t index;
-			*mpProgram >> index;
-			mpProgram->setCursorPosition(index);
-			return;
-		}
-		case OP_JUMP_COND:
-		{
-			location_t loc;
-			index_t index;
-			*mpProgram >> loc >> index;
-			if (!getLocalValue(loc).toBoolean())
-				mpProgram->setCursorPosition(index);
-			return;
-		}
+				cont.assertType(Value::TYPE_LIST | Value::TYPE_DICTIONARY);
 
-		case OP_NOT:
-		{
-			location_t loc1, loc2;
-			*mpProgram >> loc1 >> loc2;
-			getLocalValue(loc1) = !getLocalValue(loc2);
-			return;
-		}
+				if (cont.isList())
+				{
 
-		case OP_AND:
-		{
-			location_t loc1, loc2, loc3;
-			*mpProgram >> loc1 >> loc2 >> loc3;
-			getLocalValue(loc1) = getLocalValue(loc2) && getLocalValue(loc3);
-			return;
-		}
+					key.assertIsPositiveInteger();
 
-		case OP_OR:
-		{
-			location_t loc1, loc2, loc3;
-			*mpProgram >> loc1 >> loc2 >> loc3;
-			getLocalValue(loc1) = getLocalValue(loc2) || getLocalValue(loc3);
-			return;
-		}
+					size_t index = static_cast<size_t> (key.getNumber());
 
-		case OP_EQ:
-		{
-			location_t loc1, loc2, loc3;
-			*mpProgram >> loc1 >> loc2 >> loc3;
-			getLocalValue(loc1) = getLocalValue(loc2) == getLocalValue(loc3);
-			return;
-		}
+					if (index >= cont.getList().size())
+						throw RuntimeError("index out of list boundaries.");
 
-		case OP_NEQ:
-		{
-			location_t loc1, loc2, loc3;
-			*mpProgram >> loc1 >> loc2 >> loc3;
-			getLocalValue(loc1) = getLocalValue(loc2) != getLocalValue(loc3);
-			return;
-		}
+					cont.getList()[index] = base[ip->a];
 
-		case OP_GR:
-		{
-			location_t loc1, loc2, loc3;
-			*mpProgram >> loc1 >> loc2 >> loc3;
-			getLocalValue(loc1) = getLocalValue(loc2) > getLocalValue(loc3);
-			return;
-		}
+				} else
+					cont.getDictionary()[key] = base[ip->a];
 
-		case OP_GRE:
-		{
-			location_t loc1, loc2, loc3;
-			*mpProgram >> loc1 >> loc2 >> loc3;
-			getLocalValue(loc1) = getLocalValue(loc2) >= getLocalValue(loc3);
-			return;
-		}
+				VM_NEXT();
+			}
 
-		case OP_LS:
-		{
-			location_t loc1, loc2, loc3;
-			*mpProgram >> loc1 >> loc2 >> loc3;
-			getLocalValue(loc1) = getLocalValue(loc2) < getLocalValue(loc3);
-			return;
-		}
+			VM_CASE(OP_SLICE):
+				base[ip->a] = base[ip->b].slice(base[(int8_t) (ip->c & 0xFF)], base[(int8_t) ((ip->c >> 8) & 0xFF)]);
+				VM_NEXT();
 
-		case OP_LSE:
-		{
-			location_t loc1, loc2, loc3;
-			*mpProgram >> loc1 >> loc2 >> loc3;
-			getLocalValue(loc1) = getLocalValue(loc2) <= getLocalValue(loc3);
-			return;
-		}
+			VM_CASE(OP_LEN):
+			{
+				const Value& value = base[ip->b];
+				size_t length;
+
+				if (value.isList())
+					length = value.getListSize();
+				else if (value.isString())
+					length = value.getString().size();
+				else if (value.isArray())
+					length = value.getArray().getSize();
+				else
+				{
+					value.assertType(Value::TYPE_DICTIONARY);
+					length = value.getDictionary().size();
+				}
 
-		default:
-			error("Unsupported op-code.");
-			return;
-	}
-}
+				base[ip->a].setNumber(length);
+				VM_NEXT();
+			}
 
-void VirtualMachine::error(const std::string & message) const
-{
-	throw RuntimeError(message);
-}
+			VM_CASE(OP_APPEND):
+			{
+				Value& list = base[ip->b];
+				list.getListSafely().push_back(base[ip->c]);
+				if (ip->a != ip->b)
+					base[ip->a] = list;
+				VM_NEXT();
+			}
 
-void VirtualMachine::returnValue(const Value & value)
-{
-	if (mState != STATE_WAITING_FOR_RETURN)
-		throw RuntimeError("cannot return a value if a host function has not been called.");
+			VM_CASE(OP_FLOOR):
+				base[ip->a].setNumber(floor(base[ip->b].getNumberSafely()));
+				VM_NEXT();
 
-	for (size_t i = 0; i < mHostFunctionArgumentsCount; i++)
-		mValues.pop_back();
-	mValues.push_back(value);
+			VM_CASE(OP_SQRT):
+				base[ip->a].setNumber(sqrt(base[ip->b].getNumberSafely()));
+				VM_NEXT();
 
-	mState = STATE_PAUSED;
-}
+			VM_CASE(OP_ABS):
+				base[ip->a].setNumber(fabs(base[ip->b].getNumberSafely()));
+				VM_NEXT();
 
-void VirtualMachine::builtinsGroup(const FunctionCallManager & manager)
-{
-	switch (manager.getFunctionID())
-	{
-		case BFID_PRINT:
-			for (size_t i = 0; i < manager.getArgumentsCount(); i++)
+			VM_CASE(OP_MIN):
 			{
-				cout << manager.getArgument(i).toString();
-				if (i != manager.getArgumentsCount() - 1)
-					cout << " ";
+				double first = base[ip->b].getNumberSafely(), second = base[ip->c].getNumberSafely();
+				base[ip->a].setNumber((second < first) ? second : first);
+				VM_NEXT();
 			}
-			cout << endl;
-			manager.returnNil();
-			return;
 
-		case BFID_POST:
-			manager.assertArgumentType(0, Value::TYPE_STRING);
-			manager.mVM.mGlobalVariables[manager.getArgument(0).getString()] = manager.getArgument(1);
-			manager.returnValue(manager.getArgument(1));
-			return;
+			VM_CASE(OP_MAX):
+			{
+				double first = base[ip->b].getNumberSafely(), second = base[ip->c].getNumberSafely();
+				base[ip->a].setNumber((second > first) ? second : first);
+				VM_NEXT();
+			}
 
-		case BFID_GET:
-		{
-			manager.assertArgumentType(0, Value::TYPE_STRING);
-			map<string, Value>::iterator it = manager.mVM.mGlobalVariables.find(manager.getArgument(0).getString());
-			if (it == manager.mVM.mGlobalVariables.end())
-				manager.returnNil();
-			else
-				manager.returnValue(it->second);
-			return;
-		}
+			VM_CASE(OP_MOVE):
+				base[ip->a] = base[ip->b];
+				VM_NEXT();
+
+			VM_CASE(OP_ADD):
+				// "s = s + x" and "s += x" append to the string or list s in place when nothing else refers to it
+				if (ip->a == ip->b && (base[ip->a].isString() || base[ip->a].isList()))
+				{
+					base[ip->a].concatenate(base[ip->c]);
+					VM_NEXT();
+				}
+				VM_ARITHMETIC(OP_ADD_NN, +);
+
+			VM_CASE(OP_SUB):
+				VM_ARITHMETIC(OP_SUB_NN, -);
+
+			VM_CASE(OP_MUL):
+				VM_ARITHMETIC(OP_MUL_NN, *);
 
-		case BFID_LEN:
-			manager.assertArgumentType(0, Value::TYPE_STRING | Value::TYPE_LIST | Value::TYPE_DICTIONARY);
-			switch (manager.getArgument(0).getType())
+			VM_CASE(OP_DIV):
+				VM_ARITHMETIC(OP_DIV_NN, /);
+
+			VM_CASE(OP_INC):
 			{
-				case Value::TYPE_STRING:
-					manager.returnNumber(manager.getArgument(0).getString().size());
-					return;
-				case Value::TYPE_LIST:
-					manager.returnNumber(manager.getArgument(0).getList().size());
-					return;
-				case Value::TYPE_DICTIONARY:
-					manager.returnNumber(manager.getArgument(0).getDictionary().size());
-					return;
-				default: // Never executed
-					return;
+				Value& value = base[ip->a];
+				if (value.isNumber())
+					value.setNumber(value.getNumber() + numbers[ip->b]);
+				else
+					value = value + Value(numbers[ip->b]);
+				VM_NEXT();
 			}
 
+			VM_CASE(OP_DEC):
+			{
+				Value& value = base[ip->a];
+				if (value.isNumber())
+					value.setNumber(value.getNumber() - numbers[ip->b]);
+				else
+					value = value - Value(numbers[ip->b]);
+				VM_NEXT();
+			}
 
-		case BFID_APPEND:
-			manager.assertArgumentType(0, Value::TYPE_LIST);
-			manager.getArgument(0).getList().push_back(manager.getArgument(1));
-			manager.returnValue(manager.getArgument(0));
-			return;
+			VM_CASE(OP_ADDI):
+				VM_ARITHMETIC_IMMEDIATE(+);
 
-		case BFID_REMOVE:
-			manager.assertArgumentType(0, Value::TYPE_LIST);
-			manager.assertArgumentType(1, Value::TYPE_NUMBER);
-			if (!manager.getArgument(1).isInteger() || manager.getArgument(1).getNumber() < 0)
-				throw RuntimeError("the index of the element to remove must be a positive integer.");
-			manager.getArgument(0).getList().erase(manager.getArgument(0).getList().begin() + static_cast<size_t> (manager.getArgument(1).getNumber()));
-			manager.returnValue(manager.getArgument(0));
-			return;
+			VM_CASE(OP_SUBI):
+				VM_ARITHMETIC_IMMEDIATE(-);
 
-		case BFID_ASSERT:
-			if (!manager.getArgument(0).toBoolean())
-			{
-				if (manager.getArgumentsCount() == 2)
+			VM_CASE(OP_MULI):
+				VM_ARITHMETIC_IMMEDIATE(*);
+
+			VM_CASE(OP_DIVI):
+				VM_ARITHMETIC_IMMEDIATE(/);
+
+			VM_CASE(OP_JUMP):
+				// Back-edge
+				if (ip->a <= ip - code)
 				{
-					manager.assertArgumentType(1, Value::TYPE_STRING);
-					throw RuntimeError("user assertion failed: " + manager.getArgument(1).getString() + ".");
-				} else
-					throw RuntimeError("user assertion failed.");
+					ip = code + ip->a;
+					VM_CHECK_STATE();
+					VM_DISPATCH();
+				}
+				VM_JUMP(ip->a);
+
+			VM_CASE(OP_JUMP_COND):
+				if (!base[ip->a].toBoolean())
+					VM_JUMP(ip->b);
+				VM_NEXT();
+
+			VM_CASE(OP_JEQ):
+			{
+				Value& left = base[ip->a];
+				Value& right = base[ip->b];
+				if (left.isNumber() && right.isNumber() ? left.getNumber() != right.getNumber() : left != right)
+					VM_JUMP(ip->c);
+				VM_NEXT();
 			}
-			manager.returnNil();
-			return;
 
-		case BFID_DUMP:
-			manager.mVM.dump(std::cout);
-			manager.returnNil();
-			return;
+			VM_CASE(OP_JNEQ):
+			{
+				Value& left = base[ip->a];
+				Value& right = base[ip->b];
+				if (left.isNumber() && right.isNumber() ? left.getNumber() == right.getNumber() : left == right)
+					VM_JUMP(ip->c);
+				VM_NEXT();
+			}
 
-		case BFID_STR:
-			manager.returnString(manager.getArgument(0).toString());
-			return;
+			VM_CASE(OP_JGR):
+				VM_JUMP_COMPARISON(OP_JGR_NN, >);
 
-		case BFID_JOIN:
-		{
-			manager.assertArgumentType(0, Value::TYPE_STRING);
-			string result = "";
-			const string& separator = manager.getArgument(0).getString();
-			if (manager.getArgument(1).isList())
+			VM_CASE(OP_JGRE):
+				VM_JUMP_COMPARISON(OP_JGRE_NN, >=);
+
+			VM_CASE(OP_JLS):
+				VM_JUMP_COMPARISON(OP_JLS_NN, <);
+
+			VM_CASE(OP_JLSE):
+				VM_JUMP_COMPARISON(OP_JLSE_NN, <=);
+
+			VM_CASE(OP_JEQI):
+				VM_JUMP_COMPARISON_IMMEDIATE(==);
+
+			VM_CASE(OP_JNEQI):
+				VM_JUMP_COMPARISON_IMMEDIATE(!=);
+
+			VM_CASE(OP_JGRI):
+				VM_JUMP_COMPARISON_IMMEDIATE(>);
+
+			VM_CASE(OP_JGREI):
+				VM_JUMP_COMPARISON_IMMEDIATE(>=);
+
+			VM_CASE(OP_JLSI):
+				VM_JUMP_COMPARISON_IMMEDIATE(<);
+
+			VM_CASE(OP_JLSEI):
+				VM_JUMP_COMPARISON_IMMEDIATE(<=);
+
+			VM_CASE(OP_NOT):
+				base[ip->a] = !base[ip->b];
+				VM_NEXT();
+
+			VM_CASE(OP_AND):
+				base[ip->a] = base[ip->b] && base[ip->c];
+				VM_NEXT();
+
+			VM_CASE(OP_OR):
+				base[ip->a] = base[ip->b] || base[ip->c];
+				VM_NEXT();
+
+			VM_CASE(OP_EQ):
 			{
-				List& list = manager.getArgument(1).getList();
-				for (size_t i = 0; i < list.size(); i++)
-				{
-					result += list[i].toString();
-					if (i != list.size() - 1)
-						result += separator;
-				}
-			} else
+				Value& left = base[ip->b];
+				Value& right = base[ip->c];
+				if (left.isNumber() && right.isNumber())
+					base[ip->a].setBoolean(left.getNumber() == right.getNumber());
+				else
+					base[ip->a] = left == right;
+				VM_NEXT();
+			}
+
+			VM_CASE(OP_NEQ):
 			{
-				for (size_t i = 1; i < manager.getArgumentsCount(); i++)
-				{
-					result += manager.getArgument(i).toString();
-					if (i != manager.getArgumentsCount() - 1)
-						result += separator;
-				}
+				Value& left = base[ip->b];
+				Value& right = base[ip->c];
+				if (left.isNumber() && right.isNumber())
+					base[ip->a].setBoolean(left.getNumber() != right.getNumber());
+				else
+					base[ip->a] = left != right;
+				VM_NEXT();
 			}
-			manager.returnString(result);
-			return;
-		}
 
-		case BFID_ERROR:
-			manager.assertArgumentType(0, Value::TYPE_STRING);
-			throw RuntimeError(manager.getArgument(0).getString());
-			return;
+			VM_CASE(OP_GR):
+				VM_COMPARISON(OP_GR_NN, >);
+
+			VM_CASE(OP_GRE):
+				VM_COMPARISON(OP_GRE_NN, >=);
+
+			VM_CASE(OP_LS):
+				VM_COMPARISON(OP_LS_NN, <);
+
+			VM_CASE(OP_LSE):
+				VM_COMPARISON(OP_LSE_NN, <=);
+
+			VM_CASE(OP_EQI):
+				VM_COMPARISON_IMMEDIATE(==);
+
+			VM_CASE(OP_NEQI):
+				VM_COMPARISON_IMMEDIATE(!=);
+
+			VM_CASE(OP_GRI):
+				VM_COMPARISON_IMMEDIATE(>);
+
+			VM_CASE(OP_GREI):
+				VM_COMPARISON_IMMEDIATE(>=);
+
+			VM_CASE(OP_LSI):
+				VM_COMPARISON_IMMEDIATE(<);
+
+			VM_CASE(OP_LSEI):
+				VM_COMPARISON_IMMEDIATE(<=);
+
+			VM_CASE(OP_HALT):
+				mState = STATE_FINISHED;
+				VM_EXIT();
+
+			VM_CASE(OP_ADD_NN):
+				VM_ARITHMETIC_NN(OP_ADD, +);
+
+			VM_CASE(OP_SUB_NN):
+				VM_ARITHMETIC_NN(OP_SUB, -);
+
+			VM_CASE(OP_MUL_NN):
+				VM_ARITHMETIC_NN(OP_MUL, *);
 
-		default:
-			manager.returnNil();
+			VM_CASE(OP_DIV_NN):
+				VM_ARITHMETIC_NN(OP_DIV, /);
+
+			VM_CASE(OP_GR_NN):
+				VM_COMPARISON_NN(OP_GR, >);
+
+			VM_CASE(OP_GRE_NN):
+				VM_COMPARISON_NN(OP_GRE, >=);
+
+			VM_CASE(OP_LS_NN):
+				VM_COMPARISON_NN(OP_LS, <);
+
+			VM_CASE(OP_LSE_NN):
+				VM_COMPARISON_NN(OP_LSE, <=);
+
+			VM_CASE(OP_JGR_NN):
+				VM_JUMP_COMPARISON_NN(OP_JGR, >);
+
+			VM_CASE(OP_JGRE_NN):
+				VM_JUMP_COMPARISON_NN(OP_JGRE, >=);
+
+			VM_CASE(OP_JLS_NN):
+				VM_JUMP_COMPARISON_NN(OP_JLS, <);
+
+			VM_CASE(OP_JLSE_NN):
+				VM_JUMP_COMPARISON_NN(OP_JLSE, <=);
+
+#ifndef ION_SCRIPT_COMPUTED_GOTO
+			default:
+				// Never executed, the Program validates every op-code.
+				error("Unsupported op-code.");
+				return;
 	}
+#endif
+}
+
+void VirtualMachine::error(const std::string & message) const
+{
+	throw RuntimeError(message);
+}
+
+void VirtualMachine::checkCall(const Value& function, size_t nArguments) const
+{
+	if (!function.isScriptFunction())
+		throw RuntimeError("object " + function.toString() + " is not callable.");
+
+	// Check whether the required number of arguments corresponds to the one given.
+	if (function.getFunctionArgumentsCount() != nArguments)
+	{
+		stringstream ss;
+		ss << "wrong number of arguments given (" << (int) nArguments << " instead of " << (int) function.getFunctionArgumentsCount() << ").";
+		error(ss.str());
+	}
+}
+
+void VirtualMachine::fillCallCache(CallCache& cache, const Value& function, size_t nArguments) const
+{
+	checkCall(function, nArguments);
+
+	cache.function = function.mBits;
+	cache.entry = function.getFunctionIndex();
+	cache.nRegisters = function.getFunctionRegistersCount();
+}
+
+void VirtualMachine::returnValue(const Value & value, Fiber* pFiber)
+{
+	// The value of a call made by a suspended fiber is kept until the fiber is resumed.
+	if (pFiber != mpFiber)
+	{
+		if (!pFiber)
+			throw RuntimeError("cannot return a value to the program while a fiber is running.");
+		if (pFiber->mActive)
+			throw RuntimeError("cannot return a value to a fiber while it resumes another one.");
+		if (pFiber->mState != STATE_WAITING_FOR_RETURN)
+			throw RuntimeError("cannot return a value if a host function has not been called.");
+
+		pFiber->mPendingResult = value;
+		pFiber->mHasPendingResult = true;
+		pFiber->mState = STATE_PAUSED;
+		return;
+	}
+
+	if (mState != STATE_WAITING_FOR_RETURN)
+		throw RuntimeError("cannot return a value if a host function has not been called.");
+
+	// The value may be one of the arguments which are about to be removed.
+	Value result(value);
+	mValues.truncate(mValues.size() - mHostFunctionArgumentsCount);
+	mValues[mHostFunctionReturnLocation] = std::move(result);
+
+	mState = STATE_PAUSED;
 }
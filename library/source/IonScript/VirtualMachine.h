@@ -26,14 +26,21 @@
 #define ION_SCRIPT_VIRTUAL_MACHINE_H
 
 #include "Typedefs.h"
+#include "OpCode.h"
+#include "Allocator.h"
+#include "Collector.h"
+#include "Program.h"
 #include "Value.h"
 #include "FunctionCallManager.h"
+#include "HostBinding.h"
+#include "ValueStack.h"
 
 #include <iostream>
 #include <istream>
 #include <stack>
 #include <map>
-#include <list>
+#include <memory>
+#include <vector>
 
 namespace ionscript {
 
@@ -41,9 +48,14 @@ namespace ionscript {
     * This class provides all the scripting functionalities you need. It compiles source code from any input stream into bytecode which can be
     * executed in later stage. Other main functionalities are the possibility to register new host functions which can be called from the script
     * and post/get global values.
+    * A VirtualMachine may be used by one thread at a time, not necessarily the same one. The values it allocates while running
+    * scripts come from its own allocator (see setAllocator()), so they are bound to it: they must only be released by the thread
+    * using the VM at that time, or by any thread once nothing uses it anymore. The values the host creates outside of the runs
+    * come from a process-wide allocator guarded by a mutex, and can be released anywhere.
     */
    class VirtualMachine {
       friend class FunctionCallManager;
+      friend class Fiber;
 
    public:
 
@@ -54,11 +66,18 @@ namespace ionscript {
          STATE_PAUSED,
       };
 
+      /** Default capacity of the values stack, in values. */
+      static const size_t kDefaultStackCapacity = 65536;
+      /** Default capacity of the values stack of a Fiber, in values. */
+      static const size_t kDefaultFiberStackCapacity = 1024;
+
    public:
       /**
        * Constructs a new Virtual Machine.
+       * @param stackCapacity the maximum number of values the stack can hold. It is allocated at once and never grows: a script
+       *       that needs more raises a RuntimeError.
        */
-      VirtualMachine();
+      explicit VirtualMachine(size_t stackCapacity = kDefaultStackCapacity);
       /**
        * Deconstructor.
        */
@@ -85,9 +104,42 @@ namespace ionscript {
        * @param maxArgumentsCount maximum number of accepted arguments (default is -2 which means "same as min" therefore strictly min). NOTE: you can specify
        *       the value -1 for no upper limit of arguments.
        *    It's strongly suggested to have an enum for each host function group you may have that contains the IDs of the belonging functions.
+       * @param maySuspend whether the function may return without a value to suspend the VM until the value is given later. Such
+       *       functions are called through the slower VM state machine, the others return their value straight into its destination.
        * @remark If maxArgumentsCount is lesser than minArgumentsCount and not equal to -1 it is set equal to minArgumentsCount.
        */
-      void setFunction(const std::string& functionName, HostFunctionGroupID hostFunctionGroupID, FunctionID functionID, int minArgumentsCount = 0, int maxArgumentsCount = -2);
+      void setFunction(const std::string& functionName, HostFunctionGroupID hostFunctionGroupID, FunctionID functionID, int minArgumentsCount = 0, int maxArgumentsCount = -2, bool maySuspend = false);
+      /**
+       * Makes a C++ function callable by the script with the given name. Arguments are converted to the parameter types and
+       * the result back to a Value by ValueConverter, the number of arguments is the number of parameters. Bound functions
+       * skip the FunctionCallManager: the result is stored straight into its destination.
+       * @param functionName the function name, existent functions are overwritten as with setFunction().
+       * @param function the function to call, e.g. a double(double, double) or a std::string(const std::string&).
+       */
+      template <typename R, typename... Args>
+      void bind(const std::string& functionName, R(*function)(Args...)) {
+         bindFunction(functionName, new FunctionBinding<R, Args...>(function), sizeof...(Args));
+      }
+      /**
+       * Makes a member function callable by the script with the given name, as bind() does for free functions.
+       * @param functionName the function name.
+       * @param method the member function to call.
+       * @param pObject the object the member function is called on, it must outlive the VirtualMachine.
+       */
+      template <typename C, typename R, typename... Args>
+      void bind(const std::string& functionName, R(C::*method)(Args...), C* pObject) {
+         bindFunction(functionName, new MethodBinding<C, R(C::*)(Args...), R, Args...>(method, pObject), sizeof...(Args));
+      }
+      /**
+       * Makes a const member function callable by the script with the given name, as bind() does for free functions.
+       * @param functionName the function name.
+       * @param method the member function to call.
+       * @param pObject the object the member function is called on, it must outlive the VirtualMachine.
+       */
+      template <typename C, typename R, typename... Args>
+      void bind(const std::string& functionName, R(C::*method)(Args...) const, const C* pObject) {
+         bindFunction(functionName, new MethodBinding<const C, R(C::*)(Args...) const, R, Args...>(method, pObject), sizeof...(Args));
+      }
       /**
        * Gets a global variable value.
        * @param name the global variable name.
@@ -139,6 +191,14 @@ namespace ionscript {
        * @param program the bytecode to be executed.
        */
       void run(char* program);
+      /**
+       * Executes given program. A Program is immutable, so the same one can be run by many VirtualMachines at once, one per
+       * thread, without compiling or decoding it again: each VM only copies the instructions it quickens, the string constants
+       * and the call caches, once per program. Running the program that ran last keeps its quickened instructions.
+       * @param program the program to be executed. Host function groups and functions must have been registered in the same
+       *       order as in the VirtualMachine that compiled it.
+       */
+      void run(const std::shared_ptr<const Program>& program);
       /**
        * Compiles given source code and immediately runs it.
        * @param source input source stream containing the source code.
@@ -172,6 +232,72 @@ namespace ionscript {
        * @remark The VM must already have loaded the bytecode.
        */
       Value callScriptFunction(const Value& function, const Value** arguments, size_t argumentsCount);
+      /**
+       * Creates a fiber that calls given script function with no arguments once resumed.
+       * @remark The VM must already have loaded the bytecode.
+       */
+      Fiber* createFiber(const Value& function);
+      /**
+       * Creates a fiber that calls given script function with given argument once resumed.
+       * @remark The VM must already have loaded the bytecode.
+       */
+      Fiber* createFiber(const Value& function, const Value& argument);
+      /**
+       * Creates a fiber that calls given script function with given arguments once resumed. The caller owns the fiber and
+       * deletes it when done, it is not bound to the program run by run(): it may be suspended and resumed at any time.
+       * @param stackCapacity the maximum number of values the stack of the fiber can hold, allocated at once.
+       * @remark The VM must already have loaded the bytecode.
+       */
+      Fiber* createFiber(const Value& function, const Value** arguments, size_t argumentsCount, size_t stackCapacity = kDefaultFiberStackCapacity);
+      /**
+       * Runs given fiber until its function returns, a host function suspends it or pause() is called. It does nothing unless
+       * the fiber state is STATE_PAUSED. Fibers may resume other fibers from the host functions they call.
+       * @throw RuntimeError if the fiber is running or belongs to a program which is not loaded anymore. Errors raised by the
+       *       script finish the fiber and are rethrown.
+       */
+      void resume(Fiber& fiber);
+      /**
+       * Returns given value to the host function the fiber is waiting for, then resumes it.
+       * @throw RuntimeError if the fiber is not in STATE_WAITING_FOR_RETURN.
+       */
+      void resume(Fiber& fiber, const Value& result);
+      /**
+       * Frees the lists and dictionaries that are not reachable anymore but reference each other. Collections also run
+       * automatically as containers are allocated, see setCollectionThresholds(). The containers of the allocator of this VM are
+       * collected, with those of the other VirtualMachines sharing it.
+       * @return the number of freed lists and dictionaries.
+       */
+      inline size_t collect() {
+         Allocator::Scope allocatorScope(mpAllocator);
+         return Collector::collect();
+      }
+      /**
+       * Sets how many lists and dictionaries the allocator of this VM allocates between two automatic collections.
+       * @param threshold minimum number of allocations between two collections, 0 to collect only when collect() is called.
+       * @param growth fraction of the containers that survived the last collection to be allocated before the next one, so that
+       *       large heaps are not scanned too often.
+       */
+      inline void setCollectionThresholds(size_t threshold, double growth = Collector::kDefaultGrowth) {
+         Allocator::Scope allocatorScope(mpAllocator);
+         Collector::setThresholds(threshold, growth);
+      }
+
+      /**
+       * Sets the allocator of the strings, lists, dictionaries and object headers created while this VM runs scripts, by default
+       * a PoolAllocator owned by the VM. It is reset before every run, so an ArenaAllocator recycles its memory wholesale
+       * between runs whose values do not outlive them.
+       * @param pAllocator the allocator, owned by the caller, which must outlive the values it allocates. 0 restores the default.
+       * @remark the allocator must not be used by VirtualMachines running on other threads at the same time.
+       */
+      inline void setAllocator(Allocator* pAllocator) {
+         mpAllocator = pAllocator ? pAllocator : mDefaultAllocator.get();
+      }
+      /**
+       * @return the statistics of the allocator of this VM.
+       */
+      inline const AllocationStatistics& getAllocationStatistics() const {
+         return mpAllocator->getStatistics();
+      }
       /**
        * Dumps the actual status information about its memory to target output stream.
        * @param output where to print the output.
@@ -179,54 +305,135 @@ namespace ionscript {
       void dump(std::ostream& output = std::cout);
 
    private:
+      /**
+       * Owns the default allocator. It is the first member, so it is destroyed once the others have released their values: the
+       * cycles left among them are collected, and the allocator is deleted when the values still kept by the host are released.
+       */
+      class DefaultAllocator {
+      public:
+         DefaultAllocator() : mpAllocator(new PoolAllocator()) { }
+         ~DefaultAllocator() {
+            {
+               Allocator::Scope allocatorScope(mpAllocator);
+               Collector::collect();
+            }
+            mpAllocator->deleteWhenUnused();
+         }
+         inline PoolAllocator* get() const {
+            return mpAllocator;
+         }
+      private:
+         PoolAllocator* mpAllocator;
+
+         DefaultAllocator(const DefaultAllocator&);
+         DefaultAllocator & operator=(const DefaultAllocator&);
+      };
+
+      DefaultAllocator mDefaultAllocator;
       /** Actual VM state. */
       State mState;
       /** List of registered host function groups. */
       std::vector<HostFunction> mHostFunctionGroups;
       /** Map of registered host-script functions. */
       HostFunctionsMap mHostFunctionsMap;
+      /** Host functions bound by bind(), owned by the VM. */
+      std::vector<HostBinding*> mBindings;
       /** Map of global variables. */
       std::map<std::string, Value> mGlobalVariables;
-      /** The actual program bytecode reader. */
-      BytecodeReader* mpProgram;
+      /** The actual program, possibly run by other VirtualMachines at the same time. */
+      std::shared_ptr<const Program> mpProgram;
+      /** Index of the instruction to be executed when the dispatch loop is entered. */
+      index_t mIP;
       /** The stack containing all values. */
-      std::vector<Value> mValues;
+      ValueStack mValues;
 
       /** Convenient data-structure for function calls activation frames management.*/
       struct ActivationRecord {
          index_t returnIndex;
          size_t stackSize;
-         location_t firstVariableLocation;
-         ActivationRecord() : returnIndex(0), stackSize(0), firstVariableLocation(0) { }
-         ActivationRecord(index_t returnIndex, size_t stackSize, location_t firstVariableLocation) :
-         returnIndex(returnIndex), stackSize(stackSize), firstVariableLocation(firstVariableLocation) { }
+         /** Index in the values stack of the local at location 0 (an absolute index, it does not fit a location_t). */
+         size_t firstVariableLocation;
+         /** Index in the values stack where the returned value is stored. */
+         size_t returnLocation;
+         ActivationRecord() : returnIndex(0), stackSize(0), firstVariableLocation(0), returnLocation(0) { }
+         ActivationRecord(index_t returnIndex, size_t stackSize, size_t firstVariableLocation, size_t returnLocation) :
+         returnIndex(returnIndex), stackSize(stackSize), firstVariableLocation(firstVariableLocation), returnLocation(returnLocation) { }
       };
-      /** Stack of all the activation frames */
-      std::list<ActivationRecord> mActivations;
-      /** The number of arguments of the just called host function. NOTE: the VM always calls one HF at a time so there's no possibility for nested HF calls. */
-      size_t mHostFunctionArgumentsCount;
       /**
-       * Executes a single instruction.
+       * Stack of all the activation frames. It is a contiguous array reserved in advance so that calls and returns do not
+       * allocate.
        */
-      void executeInstruction();
+      std::vector<ActivationRecord> mActivations;
       /**
-       * Auxiliary function that returns the local value at given location.
+       * Inline cache of a call_sf.g or tcall_sf.g site: the bits of the function value last found in the global slot, already
+       * checked against the call, and what is needed to call it. A site whose slot has been reassigned misses and refills it.
        */
-      inline Value& getLocalValue(location_t loc) {
-         return mValues[mActivations.back().firstVariableLocation + loc];
-      }
+      struct CallCache {
+         uint64_t function;
+         index_t entry;
+         small_size_t nRegisters;
+         CallCache() : function(Value::kNoValueBits), entry(0), nRegisters(0) { }
+      };
+      /** The inline caches of the call sites of the program, indexed by the call site index of the instructions. */
+      std::vector<CallCache> mCallCaches;
+      /** The instructions of the program, copied so that they can be quickened without modifying the shared Program. */
+      std::vector<Instruction> mCode;
+      /** The string constants of the program, copied as reference counts and cached hashes are not thread-safe. */
+      std::vector<Value> mStrings;
+      /** The number of arguments of the just called host function. NOTE: the VM always calls one HF at a time so there's no possibility for nested HF calls. */
+      size_t mHostFunctionArgumentsCount;
+      /** Index in the values stack where the value returned by the just called host function is stored. */
+      size_t mHostFunctionReturnLocation;
+      /** The running fiber, 0 while running the program. */
+      Fiber* mpFiber;
+      /** The locals of the first frame of the program, which hold the global functions fibers call too. */
+      Value* mpGlobals;
+      /** The number of programs run so far, fibers are only valid within the run they were created in. */
+      unsigned int mRunsCount;
+      /** The allocator made current while running scripts. */
+      Allocator* mpAllocator;
+      /**
+       * Executes instructions until the program halts, the VM stops running or a function called by the host returns.
+       */
+      void execute();
       /**
        * Throws a RuntimeError with given message.
        * @param message message of the error.
        */
       void error(const std::string& message) const;
+      /**
+       * Throws a RuntimeError unless given value is a script function taking nArguments arguments.
+       */
+      void checkCall(const Value& function, size_t nArguments) const;
+      /**
+       * Registers a binding created by bind() under given name.
+       */
+      void bindFunction(const std::string& name, HostBinding* pBinding, int argumentsCount);
+      /**
+       * Makes the Compiler emit given op-code in place of the calls to the builtin function with given name.
+       */
+      void setIntrinsic(const std::string& name, OpCode op);
+      /**
+       * Checks a call through a call_sf.g or tcall_sf.g site whose cache missed and stores the called function in the cache.
+       */
+      void fillCallCache(CallCache& cache, const Value& function, size_t nArguments) const;
+      /**
+       * Exchanges the execution state of the VM (values stack, frames, IP, state and suspended host call) with the one of given
+       * fiber.
+       */
+      void swapExecution(Fiber& fiber);
       /**
        * This method is called by FunctionCallManager when the user wants to conclude the function call returning a certain value.
        * The value is pushed onto the value stack, the VM is unpaused and the proper number of arguments is removed from the
        * arguments stack.
        * @param value the value to return.
+       * @param pFiber the fiber that called the host function, 0 for the program. A suspended fiber receives the value when resumed.
+       */
+      void returnValue(const Value& value, Fiber* pFiber);
+      /**
+       * Registers the built-in functions and the intrinsics the compiler turns some of them into.
        */
-      void returnValue(const Value& value);
+      void registerBuiltins();
       /**
        * The function group containing built-in functions (print, len, append, ...)
        */
@@ -28,15 +28,300 @@
 
 #include <sys/types.h>
 #include <dirent.h>
+#include <unistd.h>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <cstdlib>
 #include <vector>
+#include <memory>
+#include <thread>
 
 using namespace std;
 using namespace ionscript;
 
+/* Host functions used by the scripts, registered both through a host function group and through bind(). */
+enum {
+   HFID_ADD,
+   HFID_GREET,
+   HFID_NOTHING,
+   HFID_SUSPEND,
+   HFID_SPAWN,
+   HFID_ASYNC_READ,
+   HFID_YIELD,
+   HFID_RUN_FIBERS,
+};
+
+/* The call of a function that suspended the VM, main() returns its value and resumes the VM. */
+static FunctionCallManager* pSuspendedCall = 0;
+
+/* Fibers created by spawn() and the reads they wait for, completed by runFibers() with twice the read argument. */
+struct PendingRead {
+   Fiber* pFiber;
+   double argument;
+};
+static vector<Fiber*> fibers;
+static vector<PendingRead> pendingReads;
+
+/* Runs the fibers until they have all finished and returns the sum of their results. */
+static double runFibers (VirtualMachine& vm) {
+   for (;;) {
+      // Reads completed by the stand-in I/O resume their fibers with the value read.
+      vector<PendingRead> completed;
+      completed.swap(pendingReads);
+      for (size_t i = 0; i < completed.size(); i++)
+         vm.resume(*completed[i].pFiber, Value(completed[i].argument * 2));
+
+      // Calls suspended by fibers return their value, then the fibers that yielded or received a value run again.
+      if (pSuspendedCall && pSuspendedCall->getFiber()) {
+         FunctionCallManager* pCall = pSuspendedCall;
+         pSuspendedCall = 0;
+         pCall->returnNumber(pCall->getArgument(0).getNumberSafely() * 2);
+         delete pCall;
+      }
+
+      bool finished = true;
+      for (size_t i = 0; i < fibers.size(); i++) {
+         vm.resume(*fibers[i]);
+         finished = finished && fibers[i]->isFinished();
+      }
+      if (finished)
+         break;
+   }
+
+   double total = 0;
+   for (size_t i = 0; i < fibers.size(); i++) {
+      total += fibers[i]->getResult().getNumberSafely();
+      delete fibers[i];
+   }
+   fibers.clear();
+   return total;
+}
+
+static void hostFunctions (const FunctionCallManager& manager) {
+   switch (manager.getFunctionID()) {
+      case HFID_ADD:
+         manager.returnNumber(manager.getArgument(0).getNumberSafely() + manager.getArgument(1).getNumberSafely());
+         return;
+
+      case HFID_GREET:
+         manager.returnString("hello " + manager.getArgument(0).getStringSafely());
+         return;
+
+      case HFID_NOTHING:
+         return;
+
+      case HFID_SUSPEND:
+         pSuspendedCall = new FunctionCallManager(manager);
+         return;
+
+      case HFID_SPAWN:
+         fibers.push_back(manager.getVM().createFiber(manager.getArgument(0), manager.getArgument(1)));
+         manager.returnNil();
+         return;
+
+      case HFID_ASYNC_READ:
+         // The program itself cannot wait, it reads at once.
+         if (!manager.getFiber()) {
+            manager.returnNumber(manager.getArgument(0).getNumberSafely() * 2);
+            return;
+         }
+         PendingRead read;
+         read.pFiber = manager.getFiber();
+         read.argument = manager.getArgument(0).getNumberSafely();
+         pendingReads.push_back(read);
+         return;
+
+      case HFID_YIELD:
+         manager.getVM().pause();
+         manager.returnNil();
+         return;
+
+      case HFID_RUN_FIBERS:
+         manager.returnNumber(runFibers(manager.getVM()));
+         return;
+   }
+   manager.returnNil();
+}
+
+static double add (double a, double b) {
+   return a + b;
+}
+
+static string greet (const string& name) {
+   return "hello " + name;
+}
+
+class Counter {
+public:
+   Counter () : mCount(0) { }
+   int increment (int step) {
+      mCount += step;
+      return mCount;
+   }
+   int getCount () const {
+      return mCount;
+   }
+   void reset () {
+      mCount = 0;
+   }
+private:
+   int mCount;
+};
+
+static Counter counter;
+
+static Counter* getCounter () {
+   return &counter;
+}
+
+static bool isCounter (Counter* pCounter) {
+   return pCounter == &counter;
+}
+
+/* Number of lists and dictionaries alive, for the cycle collector tests. */
+static double containersCount () {
+   return Collector::getContainersCount();
+}
+
+/* Resident memory of the process in kilobytes, 0 where /proc is not available. */
+static double residentMemory () {
+   ifstream statm("/proc/self/statm");
+   size_t pages = 0, residentPages = 0;
+   statm >> pages >> residentPages;
+   return residentPages * (sysconf(_SC_PAGESIZE) / 1024.0);
+}
+
+/* Whether given script fails with a RuntimeError when run by a VirtualMachine of its own, for the tests of errors. */
+static bool fails (const string& source) {
+   VirtualMachine context(1024);
+   vector<char> bytecode;
+   istringstream stream(source);
+   context.compile(stream, bytecode);
+   try {
+      context.run(&bytecode[0]);
+   } catch (RuntimeError&) {
+      return true;
+   }
+   return false;
+}
+
+/* The first element of a list made by a script, which the host keeps after the VirtualMachine that allocated it is destroyed. */
+static string outliveVirtualMachine (const string& source) {
+   Value kept;
+   {
+      VirtualMachine context(1024);
+      vector<char> bytecode;
+      istringstream stream(source);
+      context.compile(stream, bytecode);
+      context.run(&bytecode[0]);
+      kept = context.get("kept");
+   }
+   return kept.getList()[0].getString();
+}
+
+/* Runs given script by a VirtualMachine on a thread of its own, then destroys the VirtualMachine on the calling thread. */
+static bool runOnAnotherThread (const string& source) {
+   unique_ptr<VirtualMachine> pContext(new VirtualMachine(1024));
+   vector<char> bytecode;
+   istringstream stream(source);
+   pContext->compile(stream, bytecode);
+
+   bool succeeded = true;
+   thread worker([&pContext, &bytecode, &succeeded] () {
+      try {
+         pContext->run(&bytecode[0]);
+      } catch (exception&) {
+         succeeded = false;
+      }
+   });
+   worker.join();
+   pContext.reset();
+   return succeeded;
+}
+
+/* Host numbers that scripts reach through a typed array, without copying them. */
+static double samples[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+
+static Array* getSamples () {
+   return new Array(samples, sizeof (samples) / sizeof (samples[0]));
+}
+
+/* Sum of the host numbers computed by the host itself, which sees what the scripts changed. */
+static double samplesSum () {
+   double sum = 0;
+   for (size_t i = 0; i < sizeof (samples) / sizeof (samples[0]); i++)
+      sum += samples[i];
+   return sum;
+}
+
+static double lastElement (Array& array) {
+   return array.get(array.getSize() - 1);
+}
+
+/* A small request run by benchmarkThreads(): calls, arithmetic, string literals, lists and dictionaries. */
+static const char* kRequestScript =
+   "def fib(n)\n"
+   "   if n < 2: return n\n"
+   "   return fib(n - 1) + fib(n - 2)\n"
+   "end\n"
+   "words = split(\"the quick brown fox jumps over the lazy dog\", \" \")\n"
+   "lengths = {}\n"
+   "for i = 0; i < len(words); i += 1\n"
+   "   lengths[words[i]] = [i, len(words[i])]\n"
+   "end\n"
+   "assert(lengths[\"quick\"][1] == 5 and len(lengths) == 8, \"request dictionary mismatch\")\n"
+   "assert(fib(15) == 610, \"request fib mismatch\")\n";
+
+/*
+ * Compiles the request once and runs it on an increasing number of threads, each one with its own VirtualMachine sharing the
+ * same Program and an ArenaAllocator, and prints the throughput.
+ * @return false if a run failed.
+ */
+static bool benchmarkThreads (VirtualMachine& vm) {
+   const size_t kRunsPerThread = 200;
+
+   vector<char> bytecode;
+   istringstream source(kRequestScript);
+   vm.compile(source, bytecode);
+   shared_ptr<const Program> program(new Program(&bytecode[0]));
+
+   bool succeeded = true;
+   for (size_t nThreads = 1; nThreads <= 8; nThreads *= 2) {
+      vector<thread> threads;
+      vector<string> errors(nThreads);
+
+      Timer timer;
+      timer.reset();
+      for (size_t i = 0; i < nThreads; i++)
+         threads.push_back(thread([&program, &errors, i, kRunsPerThread] () {
+            try {
+               ArenaAllocator arena;
+               VirtualMachine context(4096);
+               context.setAllocator(&arena);
+               for (size_t run = 0; run < kRunsPerThread; run++)
+                  context.run(program);
+               // the values of a request die with it, so every run reuses the first chunk
+               if (arena.getStatistics().reservedBytes > ArenaAllocator::kChunkSize)
+                  errors[i] = "the arena was not recycled between runs";
+            } catch (exception& e) {
+               errors[i] = e.what();
+            }
+         }));
+      for (size_t i = 0; i < nThreads; i++)
+         threads[i].join();
+      double duration = timer.getDuration();
+
+      cout << "\t" << nThreads << " threads: " << (int) (nThreads * kRunsPerThread / duration) << " runs/s\n";
+      for (size_t i = 0; i < nThreads; i++)
+         if (!errors[i].empty()) {
+            cout << "XXX " << errors[i] << endl;
+            succeeded = false;
+         }
+   }
+   return succeeded;
+}
+
 int getdir (string dir, vector<string> &files) {
    DIR *dp;
    struct dirent *dirp;
@@ -75,6 +360,32 @@ int main (int argc, char** argv) {
    Timer timer;
    VirtualMachine vm;
 
+   HostFunctionGroupID hfgID = vm.registerHostFunctionGroup(hostFunctions);
+   vm.setFunction("groupAdd", hfgID, HFID_ADD, 2);
+   vm.setFunction("groupGreet", hfgID, HFID_GREET, 1);
+   vm.setFunction("nothing", hfgID, HFID_NOTHING);
+   vm.setFunction("suspend", hfgID, HFID_SUSPEND, 1, 1, true);
+   vm.setFunction("spawn", hfgID, HFID_SPAWN, 2);
+   vm.setFunction("asyncRead", hfgID, HFID_ASYNC_READ, 1, 1, true);
+   vm.setFunction("yield", hfgID, HFID_YIELD);
+   vm.setFunction("runFibers", hfgID, HFID_RUN_FIBERS);
+
+   vm.bind("add", &add);
+   vm.bind("greet", &greet);
+   vm.bind("increment", &Counter::increment, &counter);
+   vm.bind("getCount", &Counter::getCount, &counter);
+   vm.bind("reset", &Counter::reset, &counter);
+   vm.bind("getCounter", &getCounter);
+   vm.bind("isCounter", &isCounter);
+   vm.bind("containersCount", &containersCount);
+   vm.bind("residentMemory", &residentMemory);
+   vm.bind("fails", &fails);
+   vm.bind("outliveVirtualMachine", &outliveVirtualMachine);
+   vm.bind("runOnAnotherThread", &runOnAnotherThread);
+   vm.bind("getSamples", &getSamples);
+   vm.bind("samplesSum", &samplesSum);
+   vm.bind("lastElement", &lastElement);
+
    double compileDuration, execDuration;
    bool error = false;
    for (size_t i = 0; i < files.size(); i++) {
@@ -99,6 +410,15 @@ int main (int argc, char** argv) {
          cout << ">> Executing..." << endl;
          timer.reset();
          vm.run(&bytecode[0]);
+
+         // Suspended calls return twice their argument.
+         while (vm.getState() == VirtualMachine::STATE_WAITING_FOR_RETURN && pSuspendedCall) {
+            FunctionCallManager* pCall = pSuspendedCall;
+            pSuspendedCall = 0;
+            pCall->returnNumber(pCall->getArgument(0).getNumberSafely() * 2);
+            delete pCall;
+            vm.goOn();
+         }
          execDuration = timer.getDuration() * 1000;
          cout << ">> Terminated.\n\tCompilation duration: " << compileDuration << " ms\n\tExecution duration: " << execDuration << " ms.\n";
          cout << "\n";
@@ -109,6 +429,15 @@ int main (int argc, char** argv) {
       }
    }
 
+   cout << "********************************************************************************\n";
+   cout << "***";
+   centerstring("threads benchmark", 74);
+   cout << "***\n";
+   cout << "********************************************************************************\n";
+   if (!benchmarkThreads(vm))
+      error = true;
+   cout << "\n";
+
    cout << ">> Total time: " << (int) (total.getDuration()*1000) << " ms." << endl;
    if (error) {
       cout << "\tSome errors occurred." << endl;